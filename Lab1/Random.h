@@ -0,0 +1,258 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+// Small seeded PRNG module used for scene generation.
+//
+// Every generator is an independent xoshiro256** stream, so nothing is shared between
+// threads or objects. All streams derive from one global seed (SCENE_SEED environment
+// variable, or DEFAULT_SEED), which makes generated scenes reproducible between runs.
+namespace rng {
+
+constexpr uint64_t DEFAULT_SEED = 0x2545F4914F6CDD1DULL;
+
+constexpr uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// SplitMix64 step, used to expand seeds into full generator state
+constexpr uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Top 24 bits of a 64-bit value as a float in [0, 1)
+constexpr float toUnitFloat(uint64_t x) {
+    return static_cast<float>(x >> 40) * (1.0f / 16777216.0f);
+}
+
+class Xoshiro256x4;
+
+// xoshiro256** (Blackman & Vigna): 256 bits of state, period 2^256 - 1
+class Xoshiro256 {
+public:
+    constexpr explicit Xoshiro256(uint64_t seed = DEFAULT_SEED) {
+        uint64_t sm = seed;
+        for (auto& word : s)
+            word = splitMix64(sm);
+    }
+
+    // Independent stream number `stream` of `seed`; O(1), for per-object or per-thread generators
+    static constexpr Xoshiro256 forStream(uint64_t seed, uint64_t stream) {
+        uint64_t sm = stream;
+        return Xoshiro256(seed ^ splitMix64(sm));
+    }
+
+    constexpr uint64_t next() {
+        const uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+
+        return result;
+    }
+
+    // Uniform float in [0, 1)
+    constexpr float uniform() {
+        return toUnitFloat(next());
+    }
+
+    // Uniform float in [lo, hi)
+    constexpr float uniform(float lo, float hi) {
+        return lo + (hi - lo) * uniform();
+    }
+
+    // Uniform integer in [0, bound) without modulo bias (Lemire's multiply-shift)
+    constexpr uint32_t below(uint32_t bound) {
+        uint64_t m = (next() >> 32) * bound;
+        auto low = static_cast<uint32_t>(m);
+        if (low < bound) {
+            const uint32_t threshold = (0u - bound) % bound;
+            while (low < threshold) {
+                m = (next() >> 32) * bound;
+                low = static_cast<uint32_t>(m);
+            }
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+
+    // Normally distributed float (Box-Muller, the second value of each pair is kept for the next call)
+    float normal(float mean = 0.0f, float stddev = 1.0f) {
+        if (hasSpare) {
+            hasSpare = false;
+            return mean + stddev * spare;
+        }
+        const float radius = std::sqrt(-2.0f * std::log(1.0f - uniform()));
+        const float angle = 6.2831853f * uniform();
+        spare = radius * std::sin(angle);
+        hasSpare = true;
+        return mean + stddev * radius * std::cos(angle);
+    }
+
+    // Advance by 2^128 steps: the skipped range is a non-overlapping subsequence
+    constexpr void jump() {
+        constexpr uint64_t JUMP[] = {0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+                                     0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL};
+        uint64_t t[4] = {0, 0, 0, 0};
+        for (uint64_t jumpWord : JUMP) {
+            for (int b = 0; b < 64; b++) {
+                if (jumpWord & (1ULL << b)) {
+                    for (int i = 0; i < 4; i++)
+                        t[i] ^= s[i];
+                }
+                next();
+            }
+        }
+        for (int i = 0; i < 4; i++)
+            s[i] = t[i];
+    }
+
+    // Hand out the current stream and move this generator 2^128 steps ahead
+    constexpr Xoshiro256 split() {
+        Xoshiro256 child = *this;
+        child.hasSpare = false;
+        jump();
+        return child;
+    }
+
+private:
+    friend class Xoshiro256x4;  // Takes over the state of split() streams as its lanes
+
+    uint64_t s[4] = {};
+    float spare = 0.0f;
+    bool hasSpare = false;
+};
+
+// Four interleaved xoshiro256** lanes in structure-of-arrays layout. The lanes advance
+// in lock-step over plain arrays, which compilers turn into SIMD code for bulk fills.
+// Lane l starts from the state of the l-th split() of the seed's stream, so the lanes are
+// 2^128 steps apart and never overlap.
+class Xoshiro256x4 {
+public:
+    static constexpr int LANES = 4;
+
+    explicit Xoshiro256x4(uint64_t seed = DEFAULT_SEED) {
+        Xoshiro256 lane(seed);
+        for (int l = 0; l < LANES; l++) {
+            const Xoshiro256 stream = lane.split();
+            for (int w = 0; w < 4; w++)
+                s[w][l] = stream.s[w];
+        }
+    }
+
+    void next(uint64_t out[LANES]) {
+        for (int l = 0; l < LANES; l++) {
+            out[l] = rotl(s[1][l] * 5, 7) * 9;
+            const uint64_t t = s[1][l] << 17;
+
+            s[2][l] ^= s[0][l];
+            s[3][l] ^= s[1][l];
+            s[1][l] ^= s[2][l];
+            s[0][l] ^= s[3][l];
+            s[2][l] ^= t;
+            s[3][l] = rotl(s[3][l], 45);
+        }
+    }
+
+    // Fill out[0..count) with uniform floats in [lo, hi)
+    void fillUniform(float* out, size_t count, float lo, float hi) {
+        const float range = hi - lo;
+        uint64_t bits[LANES];
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES) {
+            next(bits);
+            for (int l = 0; l < LANES; l++)
+                out[i + l] = lo + range * toUnitFloat(bits[l]);
+        }
+        if (i < count) {
+            next(bits);
+            for (int l = 0; i < count; l++, i++)
+                out[i] = lo + range * toUnitFloat(bits[l]);
+        }
+    }
+
+    // Fill out[0..count) with normally distributed floats (Box-Muller on lane pairs)
+    void fillNormal(float* out, size_t count, float mean, float stddev) {
+        uint64_t bits[LANES];
+        float values[LANES];
+        size_t i = 0;
+        while (i < count) {
+            next(bits);
+            for (int p = 0; p < LANES / 2; p++) {
+                const float radius = std::sqrt(-2.0f * std::log(1.0f - toUnitFloat(bits[2 * p])));
+                const float angle = 6.2831853f * toUnitFloat(bits[2 * p + 1]);
+                values[2 * p] = mean + stddev * radius * std::cos(angle);
+                values[2 * p + 1] = mean + stddev * radius * std::sin(angle);
+            }
+            for (int l = 0; l < LANES && i < count; l++, i++)
+                out[i] = values[l];
+        }
+    }
+
+private:
+    uint64_t s[4][LANES] = {};  // State word, then lane
+};
+
+namespace detail {
+    inline std::atomic<uint64_t> seedOverride{0};
+    inline std::atomic<bool> hasSeedOverride{false};
+    inline std::atomic<uint64_t> seedEpoch{1};
+    inline std::atomic<uint64_t> nextThreadOrdinal{0};
+
+    inline uint64_t threadOrdinal() {
+        thread_local const uint64_t ordinal = nextThreadOrdinal.fetch_add(1, std::memory_order_relaxed);
+        return ordinal;
+    }
+}
+
+// Seed from the SCENE_SEED environment variable, or DEFAULT_SEED when it is not set
+inline uint64_t seedFromEnvironment() {
+    const char* value = std::getenv("SCENE_SEED");
+    if (!value || !*value)
+        return DEFAULT_SEED;
+    return std::strtoull(value, nullptr, 0);
+}
+
+// Global seed every stream derives from. Safe to call during static initialization.
+inline uint64_t globalSeed() {
+    if (detail::hasSeedOverride.load(std::memory_order_acquire))
+        return detail::seedOverride.load(std::memory_order_relaxed);
+    static const uint64_t environmentSeed = seedFromEnvironment();
+    return environmentSeed;
+}
+
+// Replace the global seed; thread generators reseed themselves on their next use
+inline void setGlobalSeed(uint64_t seed) {
+    detail::seedOverride.store(seed, std::memory_order_relaxed);
+    detail::hasSeedOverride.store(true, std::memory_order_release);
+    detail::seedEpoch.fetch_add(1, std::memory_order_acq_rel);
+}
+
+// Generator owned by the calling thread, stream number = order in which threads first asked
+inline Xoshiro256& threadRng() {
+    thread_local Xoshiro256 generator;
+    thread_local uint64_t generatorEpoch = 0;
+
+    const uint64_t epoch = detail::seedEpoch.load(std::memory_order_acquire);
+    if (generatorEpoch != epoch) {
+        generator = Xoshiro256::forStream(globalSeed(), detail::threadOrdinal());
+        generatorEpoch = epoch;
+    }
+    return generator;
+}
+
+}
+
+#endif //RANDOM_H
@@ -0,0 +1,312 @@
+#ifndef SHADERPROGRAM_H
+#define SHADERPROGRAM_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// 64-bit FNV-1a hash of a uniform name, usable at compile time
+constexpr uint64_t uniformNameHash(const char* name, size_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Uniform name whose hash is computed at compile time, so a lookup by a string literal only
+// compares integers at run time
+class UniformName {
+public:
+    template <size_t N>
+    consteval UniformName(const char (&name)[N]) : name(name), hash(uniformNameHash(name, N - 1)) {}
+
+    const char* name;
+    uint64_t hash;
+};
+
+// glProgramUniform needs GL 4.1 or ARB_separate_shader_objects. Without either, uniformUpload
+// binds the program for a glUniform call and restores the previous one, so callers, and a
+// state cache that shadows the bound program, see no difference.
+inline bool directUniformUploadSupported() {
+    static const bool supported = GLEW_VERSION_4_1 || GLEW_ARB_separate_shader_objects;
+    return supported;
+}
+
+template <typename Direct, typename Bound>
+void uniformUpload(GLuint program, Direct direct, Bound bound) {
+    if (directUniformUploadSupported()) {
+        direct();
+        return;
+    }
+    GLint current = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+    const bool rebind = static_cast<GLuint>(current) != program;
+    if (rebind)
+        glUseProgram(program);
+    bound();
+    if (rebind)
+        glUseProgram(static_cast<GLuint>(current));
+}
+
+// GL types a C++ value type may be uploaded to, and the calls that upload it. Stored is the
+// value as the shadow copy keeps it.
+template <typename T>
+struct UniformTraits;
+
+template <>
+struct UniformTraits<float> {
+    using Stored = float;
+    static bool accepts(GLenum type) { return type == GL_FLOAT; }
+    static Stored store(float value) { return value; }
+    static void upload(GLuint program, GLint location, const Stored& value) {
+        uniformUpload(program, [&] { glProgramUniform1f(program, location, value); },
+                      [&] { glUniform1f(location, value); });
+    }
+};
+
+template <>
+struct UniformTraits<int> {
+    using Stored = GLint;
+    // Samplers are set through glUniform1i as well
+    static bool accepts(GLenum type) {
+        return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_3D
+            || type == GL_SAMPLER_CUBE || type == GL_SAMPLER_2D_ARRAY || type == GL_SAMPLER_BUFFER;
+    }
+    static Stored store(int value) { return value; }
+    static void upload(GLuint program, GLint location, const Stored& value) {
+        uniformUpload(program, [&] { glProgramUniform1i(program, location, value); },
+                      [&] { glUniform1i(location, value); });
+    }
+};
+
+template <>
+struct UniformTraits<bool> {
+    using Stored = GLint;
+    static bool accepts(GLenum type) { return type == GL_BOOL || type == GL_INT; }
+    static Stored store(bool value) { return value ? 1 : 0; }
+    static void upload(GLuint program, GLint location, const Stored& value) {
+        uniformUpload(program, [&] { glProgramUniform1i(program, location, value); },
+                      [&] { glUniform1i(location, value); });
+    }
+};
+
+template <>
+struct UniformTraits<glm::vec2> {
+    using Stored = glm::vec2;
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC2; }
+    static Stored store(const glm::vec2& value) { return value; }
+    static void upload(GLuint program, GLint location, const Stored& value) {
+        uniformUpload(program, [&] { glProgramUniform2fv(program, location, 1, glm::value_ptr(value)); },
+                      [&] { glUniform2fv(location, 1, glm::value_ptr(value)); });
+    }
+};
+
+template <>
+struct UniformTraits<glm::vec3> {
+    using Stored = glm::vec3;
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC3; }
+    static Stored store(const glm::vec3& value) { return value; }
+    static void upload(GLuint program, GLint location, const Stored& value) {
+        uniformUpload(program, [&] { glProgramUniform3fv(program, location, 1, glm::value_ptr(value)); },
+                      [&] { glUniform3fv(location, 1, glm::value_ptr(value)); });
+    }
+};
+
+template <>
+struct UniformTraits<glm::vec4> {
+    using Stored = glm::vec4;
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC4; }
+    static Stored store(const glm::vec4& value) { return value; }
+    static void upload(GLuint program, GLint location, const Stored& value) {
+        uniformUpload(program, [&] { glProgramUniform4fv(program, location, 1, glm::value_ptr(value)); },
+                      [&] { glUniform4fv(location, 1, glm::value_ptr(value)); });
+    }
+};
+
+template <>
+struct UniformTraits<glm::mat3> {
+    using Stored = glm::mat3;
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT3; }
+    static Stored store(const glm::mat3& value) { return value; }
+    static void upload(GLuint program, GLint location, const Stored& value) {
+        uniformUpload(program, [&] { glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, glm::value_ptr(value)); },
+                      [&] { glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value)); });
+    }
+};
+
+template <>
+struct UniformTraits<glm::mat4> {
+    using Stored = glm::mat4;
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT4; }
+    static Stored store(const glm::mat4& value) { return value; }
+    static void upload(GLuint program, GLint location, const Stored& value) {
+        uniformUpload(program, [&] { glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, glm::value_ptr(value)); },
+                      [&] { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); });
+    }
+};
+
+// Typed handle to one entry of a ShaderProgram's uniform table; setting an invalid handle
+// (a uniform the linker removed) does nothing, like location -1
+template <typename T>
+struct Uniform {
+    int slot = -1;
+
+    bool valid() const {
+        return slot >= 0;
+    }
+};
+
+// One active uniform as reported by glGetActiveUniform. Arrays are listed once, under their
+// name without "[0]", and set through their first element.
+struct UniformInfo {
+    std::string name;
+    uint64_t hash;
+    GLenum type;
+    GLint size;
+    GLint location;
+    uint32_t shadowOffset;
+    uint32_t shadowSize;
+    bool shadowValid;
+};
+
+// Uniform interface of a linked program, reflected once into a flat table. Setters upload
+// with glProgramUniform where available, so the program need not be bound, and skip values equal to the
+// shadow copy of the last upload. Every upload to the program has to go through the
+// wrapper for the shadow copy to stay right. The program itself is not owned.
+class ShaderProgram {
+public:
+    ShaderProgram() = default;
+
+    explicit ShaderProgram(GLuint program) {
+        reset(program);
+    }
+
+    // Reflects the active uniforms of program; handles taken from the previous one are stale
+    void reset(GLuint newProgram) {
+        program = newProgram;
+        table.clear();
+        shadow.clear();
+
+        GLint uniformCount = 0, maxNameLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+        std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+
+        uint32_t shadowBytes = 0;
+        for (GLint i = 0; i < uniformCount; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()), &length,
+                               &size, &type, nameBuffer.data());
+
+            std::string name(nameBuffer.data(), length);
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+                name.resize(name.size() - 3);
+
+            // Members of uniform blocks have no location and are not set one by one
+            const GLint location = glGetUniformLocation(program, name.c_str());
+            if (location < 0)
+                continue;
+
+            UniformInfo info;
+            info.hash = uniformNameHash(name.data(), name.size());
+            info.name = std::move(name);
+            info.type = type;
+            info.size = size;
+            info.location = location;
+            info.shadowOffset = shadowBytes;
+            info.shadowSize = shadowSize(type);
+            info.shadowValid = false;
+            shadowBytes += info.shadowSize;
+            table.push_back(std::move(info));
+        }
+        shadow.assign(shadowBytes, 0);
+    }
+
+    GLuint id() const {
+        return program;
+    }
+
+    void use() const {
+        glUseProgram(program);
+    }
+
+    const std::vector<UniformInfo>& uniforms() const {
+        return table;
+    }
+
+    // Handle to a uniform; invalid if the program has no such uniform or it is of another type
+    template <typename T>
+    Uniform<T> uniform(UniformName name) const {
+        Uniform<T> handle;
+        for (size_t i = 0; i < table.size(); i++) {
+            if (table[i].hash != name.hash)
+                continue;
+            if (UniformTraits<T>::accepts(table[i].type))
+                handle.slot = static_cast<int>(i);
+            else
+                std::cerr << "ERROR: Uniform " << name.name << " does not have the requested type" << std::endl;
+            break;
+        }
+        return handle;
+    }
+
+    template <typename T>
+    void set(Uniform<T> handle, const std::type_identity_t<T>& value) {
+        if (!handle.valid())
+            return;
+
+        using Traits = UniformTraits<T>;
+        const typename Traits::Stored stored = Traits::store(value);
+        UniformInfo& info = table[handle.slot];
+        unsigned char* copy = shadow.data() + info.shadowOffset;
+        if (info.shadowValid && std::memcmp(copy, &stored, sizeof(stored)) == 0)
+            return;
+
+        std::memcpy(copy, &stored, sizeof(stored));
+        info.shadowValid = true;
+        Traits::upload(program, info.location, stored);
+    }
+
+    // By name: the lookup is a scan of the table comparing precomputed hashes
+    template <typename T>
+    void set(UniformName name, const T& value) {
+        set(uniform<T>(name), value);
+    }
+
+    // Forgets the shadow copy, for when the program's uniforms were changed behind the wrapper
+    void invalidate() {
+        for (UniformInfo& info : table)
+            info.shadowValid = false;
+    }
+
+private:
+    // Bytes of one element as the matching UniformTraits<T>::Stored keeps it
+    static uint32_t shadowSize(GLenum type) {
+        switch (type) {
+            case GL_FLOAT_VEC2: return sizeof(glm::vec2);
+            case GL_FLOAT_VEC3: return sizeof(glm::vec3);
+            case GL_FLOAT_VEC4: return sizeof(glm::vec4);
+            case GL_FLOAT_MAT3: return sizeof(glm::mat3);
+            case GL_FLOAT_MAT4: return sizeof(glm::mat4);
+            case GL_FLOAT: return sizeof(float);
+            default: return sizeof(GLint);
+        }
+    }
+
+    GLuint program = 0;
+    std::vector<UniformInfo> table;
+    std::vector<unsigned char> shadow;
+};
+
+#endif //SHADERPROGRAM_H
@@ -3,7 +3,6 @@
 #include <GLFW/glfw3.h>
 #include <vector>
 #include <cstdlib>
-#include <ctime>
 #include <sstream>
 #include <map>
 #include <ft2build.h>
@@ -11,6 +10,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "Random.h"
+#include "ShaderCache.h"
+#include "GLStateCache.h"
+#include "ShaderProgram.h"
 
 // Shader sources
 const char* vertexShaderSource = R"(
@@ -76,6 +79,8 @@ struct Character {
 // Global variables
 GLuint shaderProgram, VAO, VBO;
 GLuint textShaderProgram, textVAO, textVBO;
+ShaderProgram mainShader, textShader; // Reflected uniforms of shaderProgram and textShaderProgram
+GLStateCache glState; // Drops state calls that would not change anything
 std::vector<Square> squares; // Vector to store squares
 std::map<char, Character> Characters; // Map of characters for text rendering
 glm::mat4 projection; // Projection matrix for text rendering
@@ -119,25 +124,16 @@ bool initOpenGL(GLFWwindow*& window) {
 
 // Initialize shaders and buffers
 void initShadersAndBuffers() {
-    // Compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
-
-    // Compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-
-    // Link shaders to a program
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glUseProgram(shaderProgram);
+    // Linked programs are kept as driver binaries in shader_cache/ and reloaded from there on later runs
+    ProgramCache programCache("shader_cache");
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // Compile and link the main program, or load its cached binary
+    shaderProgram = programCache.load("main", {
+        {GL_VERTEX_SHADER, vertexShaderSource},
+        {GL_FRAGMENT_SHADER, fragmentShaderSource},
+    });
+    mainShader.reset(shaderProgram);
+    glUseProgram(shaderProgram);
 
     // Set up vertex data for a square (4 vertices)
     GLfloat vertices[] = {
@@ -160,21 +156,11 @@ void initShadersAndBuffers() {
     glBindVertexArray(0); // Unbind VAO
 
     // Initialize text shaders
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &textVertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
-
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &textFragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-
-    textShaderProgram = glCreateProgram();
-    glAttachShader(textShaderProgram, vertexShader);
-    glAttachShader(textShaderProgram, fragmentShader);
-    glLinkProgram(textShaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    textShaderProgram = programCache.load("text", {
+        {GL_VERTEX_SHADER, textVertexShaderSource},
+        {GL_FRAGMENT_SHADER, textFragmentShaderSource},
+    });
+    textShader.reset(textShaderProgram);
 
     // Initialize text VAO and VBO
     glGenVertexArrays(1, &textVAO);
@@ -261,11 +247,11 @@ bool initFont() {
 // Render a text string
 void renderText(const std::string& text, float x, float y, float scale, glm::vec3 color) {
     // Activate corresponding render state
-    glUseProgram(textShaderProgram);
-    glUniform3f(glGetUniformLocation(textShaderProgram, "textColor"), color.x, color.y, color.z);
-    glUniformMatrix4fv(glGetUniformLocation(textShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(textVAO);
+    glState.useProgram(textShaderProgram);
+    textShader.set("textColor", color);
+    textShader.set("projection", projection);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindVertexArray(textVAO);
 
     // Iterate through all characters
     float startX = x;
@@ -290,12 +276,11 @@ void renderText(const std::string& text, float x, float y, float scale, glm::vec
         };
 
         // Render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
+        glState.bindTexture(GL_TEXTURE_2D, ch.TextureID);
 
         // Update content of VBO memory
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+        glState.bindBuffer(GL_ARRAY_BUFFER, textVBO);
         glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
         // Render quad
         glDrawArrays(GL_TRIANGLES, 0, 6);
@@ -303,8 +288,6 @@ void renderText(const std::string& text, float x, float y, float scale, glm::vec
         // Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         startX += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 // Function to invert color
@@ -326,12 +309,16 @@ void normalizedToWindowCoords(float& x, float& y) {
 
 // Draw the squares with labels
 void drawSquares() {
+    // Squares are opaque, so blending for the labels can stay on for the whole pass
+    glState.enable(GL_BLEND);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
     for (const auto& square : squares) {
         // --- Square Render ---
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO);
+        glState.useProgram(shaderProgram);
+        glState.bindVertexArray(VAO);
         // Set the square color
-        glUniform4f(glGetUniformLocation(shaderProgram, "squareColor"), square.color[0], square.color[1], square.color[2], 1.0f);
+        mainShader.set("squareColor", glm::vec4(square.color[0], square.color[1], square.color[2], 1.0f));
 
         GLfloat model[] = {
             square.x - square.size, square.y - square.size,
@@ -340,16 +327,11 @@ void drawSquares() {
             square.x + square.size, square.y + square.size
         };
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(model), model, GL_STATIC_DRAW);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-        glBindVertexArray(0);
-
         // --- Text Render ---
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
         GLfloat invertedColor[3];
         invertColor(square.color, invertedColor);
 
@@ -370,8 +352,6 @@ void drawSquares() {
 
         // Render the text with inverted color for better visibility
         renderText(ss.str(), textX, textY, 0.5f, glm::vec3(invertedColor[0], invertedColor[1], invertedColor[2]));
-
-        glDisable(GL_BLEND);
     }
 }
 
@@ -386,20 +366,21 @@ void handleKeyboardInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS) {
         if (!zPressed) {
             Square newSquare{};
+            rng::Xoshiro256& random = rng::threadRng();
 
             // Generate positions in pixel space
-            const auto x = static_cast<float>(arc4random() % width);
-            const auto y = static_cast<float>(arc4random() % height);
+            const auto x = static_cast<float>(random.below(width));
+            const auto y = static_cast<float>(random.below(height));
 
             // Convert pixel coordinates to OpenGL normalized coordinates
             newSquare.x = x / static_cast<float>(width) * 2.0f - 1.0f;
             newSquare.y = y / static_cast<float>(height) * 2.0f - 1.0f;
 
-            newSquare.size = static_cast<float>(arc4random() % 200 + 50) / static_cast<float>(width);
+            newSquare.size = static_cast<float>(random.below(200) + 50) / static_cast<float>(width);
 
-            newSquare.color[0] = static_cast<float>(arc4random() % 100) / 100.0f;
-            newSquare.color[1] = static_cast<float>(arc4random() % 100) / 100.0f;
-            newSquare.color[2] = static_cast<float>(arc4random() % 100) / 100.0f;
+            newSquare.color[0] = static_cast<float>(random.below(100)) / 100.0f;
+            newSquare.color[1] = static_cast<float>(random.below(100)) / 100.0f;
+            newSquare.color[2] = static_cast<float>(random.below(100)) / 100.0f;
 
             squares.push_back(newSquare);
             zPressed = true;
@@ -437,8 +418,6 @@ void mainLoop(GLFWwindow* window) {
 }
 
 int main() {
-    srand(time(0)); // Seed for random number generation
-
     GLFWwindow* window;
 
     // Initialize OpenGL
@@ -457,6 +436,9 @@ int main() {
     // Start the main loop
     mainLoop(window);
 
+    const GLStateCounters& stateCalls = glState.counters();
+    std::cout << "GL state calls: " << stateCalls.issued << " issued, " << stateCalls.elided << " elided" << std::endl;
+
     // Clean up and terminate
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
@@ -0,0 +1,244 @@
+#ifndef LINERENDERER_H
+#define LINERENDERER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include "GLStateCache.h"
+#include "ShaderCache.h"
+#include "ShaderProgram.h"
+
+enum class ELineJoin {
+    Miter = 0,
+    Round = 1,
+};
+
+// Batched thick-line renderer for the core profile, where glLineWidth > 1 and GL_LINE_SMOOTH
+// are not available. Every segment is one instance; the vertex shader expands it into a
+// screen-space quad (with miter or round joins) and the fragment shader computes analytic
+// coverage from the distance to the segment, so all queued polylines go out in one draw call.
+class LineRenderer {
+public:
+    ELineJoin join = ELineJoin::Miter;
+    float miterLimit = 4.0f;  // Miter length (in half-widths) above which a join falls back to round
+
+    bool init(const ProgramCache& programCache) {
+        program = programCache.load("line", {
+            {GL_VERTEX_SHADER, lineVertexShaderSource},
+            {GL_FRAGMENT_SHADER, lineFragmentShaderSource},
+        });
+
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            std::cerr << "ERROR: Line shader program linking failed" << std::endl;
+            return false;
+        }
+
+        uniforms.reset(program);
+        viewportSizeUniform = uniforms.uniform<glm::vec2>("viewportSize");
+        joinTypeUniform = uniforms.uniform<int>("joinType");
+        miterLimitUniform = uniforms.uniform<float>("miterLimit");
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+        // One Segment per instance, nothing per vertex: corners come from gl_VertexID
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Segment), (void*)offsetof(Segment, prevStart));
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Segment), (void*)offsetof(Segment, endNext));
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Segment), (void*)offsetof(Segment, color));
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Segment), (void*)offsetof(Segment, widthFlags));
+        for (GLuint i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(i);
+            glVertexAttribDivisor(i, 1);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        return true;
+    }
+
+    // Queue a polyline given in normalized device coordinates; width is in pixels
+    void addPolyline(const std::vector<glm::vec2>& points, float width, const glm::vec4& color, bool closed = false) {
+        const size_t count = points.size();
+        if (count < 2)
+            return;
+
+        const size_t segmentCount = closed ? count : count - 1;
+        for (size_t i = 0; i < segmentCount; i++) {
+            const size_t start = i;
+            const size_t end = (i + 1) % count;
+
+            const bool hasPrev = closed || i > 0;
+            const bool hasNext = closed || i + 1 < segmentCount;
+            const glm::vec2 prev = hasPrev ? points[(start + count - 1) % count] : points[start];
+            const glm::vec2 next = hasNext ? points[(end + 1) % count] : points[end];
+
+            Segment segment;
+            segment.prevStart = glm::vec4(prev.x, prev.y, points[start].x, points[start].y);
+            segment.endNext = glm::vec4(points[end].x, points[end].y, next.x, next.y);
+            segment.color = color;
+            segment.widthFlags = glm::vec2(width, static_cast<float>((hasPrev ? 1 : 0) | (hasNext ? 2 : 0)));
+            segments.push_back(segment);
+        }
+    }
+
+    void addLine(const glm::vec2& a, const glm::vec2& b, float width, const glm::vec4& color) {
+        addPolyline({a, b}, width, color);
+    }
+
+    void clear() {
+        segments.clear();
+    }
+
+    // Upload everything queued since the last clear() and draw it with a single instanced call
+    void draw(GLStateCache& state, int viewportWidth, int viewportHeight) {
+        if (segments.empty())
+            return;
+
+        state.bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, segments.size() * sizeof(Segment), segments.data(), GL_STREAM_DRAW);
+
+        state.useProgram(program);
+        uniforms.set(viewportSizeUniform, glm::vec2(static_cast<float>(viewportWidth), static_cast<float>(viewportHeight)));
+        uniforms.set(joinTypeUniform, static_cast<int>(join));
+        uniforms.set(miterLimitUniform, miterLimit);
+
+        state.enable(GL_BLEND);
+        state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        state.bindVertexArray(vao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(segments.size()));
+    }
+
+    void destroy() {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteProgram(program);
+    }
+
+private:
+    struct Segment {
+        glm::vec4 prevStart;   // Previous point xy, segment start xy
+        glm::vec4 endNext;     // Segment end xy, next point xy
+        glm::vec4 color;
+        glm::vec2 widthFlags;  // Width in pixels, bit 0 = has previous segment, bit 1 = has next segment
+    };
+
+    static constexpr const char* lineVertexShaderSource = R"(
+        #version 410 core
+        layout (location = 0) in vec4 aPrevStart;
+        layout (location = 1) in vec4 aEndNext;
+        layout (location = 2) in vec4 aColor;
+        layout (location = 3) in vec2 aWidthFlags;
+
+        uniform vec2 viewportSize;
+        uniform int joinType;
+        uniform float miterLimit;
+
+        out vec4 vColor;
+        noperspective out vec2 vLocal;   // Position along / across the segment in pixels
+        flat out float vLength;
+        flat out float vHalfWidth;
+        flat out int vRoundStart;
+        flat out int vRoundEnd;
+
+        vec2 toScreen(vec2 ndc) {
+            return (ndc * 0.5 + 0.5) * viewportSize;
+        }
+
+        // Offset of a quad corner at a segment end: miter against the neighbouring segment when
+        // there is one and the miter is short enough, otherwise a round cap extension
+        vec2 cornerOffset(vec2 neighbour, vec2 point, vec2 dir, vec2 normal, float side, float extent,
+                          bool hasNeighbour, float capSign, out bool isRound) {
+            vec2 neighbourDir = (point - neighbour) * capSign;
+            if (joinType == 0 && hasNeighbour && length(neighbourDir) > 1e-4) {
+                neighbourDir = normalize(neighbourDir);
+                vec2 normalSum = vec2(-neighbourDir.y, neighbourDir.x) + normal;
+                vec2 miter = length(normalSum) > 1e-4 ? normalize(normalSum) : vec2(0.0);
+                float denom = dot(miter, normal);
+                if (denom > 1.0 / miterLimit) {
+                    isRound = false;
+                    return miter * side * (extent / denom);
+                }
+            }
+            isRound = true;
+            return normal * side * extent - dir * capSign * extent;
+        }
+
+        void main() {
+            float side = (gl_VertexID & 1) == 0 ? -1.0 : 1.0;
+            bool atEnd = gl_VertexID >= 2;
+            int flags = int(aWidthFlags.y + 0.5);
+
+            vec2 prev = toScreen(aPrevStart.xy);
+            vec2 a = toScreen(aPrevStart.zw);
+            vec2 b = toScreen(aEndNext.xy);
+            vec2 next = toScreen(aEndNext.zw);
+
+            float len = length(b - a);
+            vec2 dir = len > 1e-4 ? (b - a) / len : vec2(1.0, 0.0);
+            vec2 normal = vec2(-dir.y, dir.x);
+
+            float halfWidth = aWidthFlags.x * 0.5;
+            float extent = halfWidth + 1.0;  // One pixel of fringe for the coverage ramp
+
+            bool roundStart, roundEnd;
+            vec2 startOffset = cornerOffset(prev, a, dir, normal, side, extent, (flags & 1) != 0, 1.0, roundStart);
+            vec2 endOffset = cornerOffset(next, b, dir, normal, side, extent, (flags & 2) != 0, -1.0, roundEnd);
+
+            vec2 position = atEnd ? b + endOffset : a + startOffset;
+            vec2 fromStart = position - a;
+
+            vColor = aColor;
+            vLocal = vec2(dot(fromStart, dir), dot(fromStart, normal));
+            vLength = len;
+            vHalfWidth = halfWidth;
+            vRoundStart = roundStart ? 1 : 0;
+            vRoundEnd = roundEnd ? 1 : 0;
+
+            gl_Position = vec4(position / viewportSize * 2.0 - 1.0, 0.0, 1.0);
+        }
+    )";
+
+    static constexpr const char* lineFragmentShaderSource = R"(
+        #version 410 core
+        in vec4 vColor;
+        noperspective in vec2 vLocal;
+        flat in float vLength;
+        flat in float vHalfWidth;
+        flat in int vRoundStart;
+        flat in int vRoundEnd;
+
+        out vec4 FragColor;
+
+        void main() {
+            // Distance to the segment; mitered ends are bounded by the quad itself
+            float distance = abs(vLocal.y);
+            if (vLocal.x < 0.0 && vRoundStart == 1)
+                distance = length(vLocal);
+            else if (vLocal.x > vLength && vRoundEnd == 1)
+                distance = length(vec2(vLocal.x - vLength, vLocal.y));
+
+            float coverage = clamp(vHalfWidth + 0.5 - distance, 0.0, 1.0);
+            if (coverage <= 0.0)
+                discard;
+
+            FragColor = vec4(vColor.rgb, vColor.a * coverage);
+        }
+    )";
+
+    GLuint program = 0, vao = 0, vbo = 0;
+    ShaderProgram uniforms;
+    Uniform<glm::vec2> viewportSizeUniform;
+    Uniform<int> joinTypeUniform;
+    Uniform<float> miterLimitUniform;
+    std::vector<Segment> segments;
+};
+
+#endif //LINERENDERER_H
@@ -12,25 +12,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-// Shader sources
-const char* vertexShaderSource = R"(
-    #version 410 core
-    layout (location = 0) in vec2 aPos;
-    void main() {
-        gl_Position = vec4(aPos, 0.0, 1.0);
-    }
-)";
-
-const char* fragmentShaderSource = R"(
-    #version 410 core
-    out vec4 FragColor;
-    uniform vec4 squareColor;
-    void main() {
-        FragColor = squareColor;
-    }
-)";
+#include "LineRenderer.h"
+#include "ShaderCache.h"
+#include "GLStateCache.h"
+#include "ShaderProgram.h"
 
-// Text rendering shader sources
+// Shader sources
 const char* textVertexShaderSource = R"(
     #version 410 core
     layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
@@ -66,9 +53,21 @@ struct Character {
     unsigned int Advance;   // Offset to advance to next glyph
 };
 
+// Structure to store a coordinate label queued for rendering after the lines
+struct AxisLabel {
+    std::string text;
+    float x, y;
+};
+
 // Global variables
-GLuint shaderProgram, VAO, VBO;
 GLuint textShaderProgram, textVAO, textVBO;
+ShaderProgram textShader; // Reflected uniforms of textShaderProgram
+GLStateCache glState; // Drops state calls that would not change anything
+
+// Linked programs are kept as driver binaries in shader_cache/ and reloaded from there on later runs
+ProgramCache programCache("shader_cache");
+LineRenderer lineRenderer; // Batched renderer for axes and the function graph
+std::vector<AxisLabel> axisLabels;
 float scale = 1.0f;
 int windowWidth, windowHeight;
 float a = 1.0f;
@@ -117,62 +116,12 @@ bool initOpenGL(GLFWwindow*& window) {
 
 // Initialize shaders and buffers
 void initShadersAndBuffers() {
-    // Compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
-
-    // Compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-
-    // Link shaders to a program
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glUseProgram(shaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    // Set up vertex data for a square (4 vertices)
-    GLfloat vertices[] = {
-        -0.5f, -0.5f,  // Bottom-left
-         0.5f, -0.5f,  // Bottom-right
-        -0.5f,  0.5f,  // Top-left
-         0.5f,  0.5f   // Top-right
-    };
-
-    // Set up buffers
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0); // Unbind VAO
-
     // Initialize text shaders
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &textVertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
-
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &textFragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-
-    textShaderProgram = glCreateProgram();
-    glAttachShader(textShaderProgram, vertexShader);
-    glAttachShader(textShaderProgram, fragmentShader);
-    glLinkProgram(textShaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    textShaderProgram = programCache.load("text", {
+        {GL_VERTEX_SHADER, textVertexShaderSource},
+        {GL_FRAGMENT_SHADER, textFragmentShaderSource},
+    });
+    textShader.reset(textShaderProgram);
 
     // Initialize text VAO and VBO
     glGenVertexArrays(1, &textVAO);
@@ -259,11 +208,11 @@ bool initFont() {
 // Render a text string
 void renderText(const std::string& text, float x, float y, float scale, glm::vec3 color) {
     // Activate corresponding render state
-    glUseProgram(textShaderProgram);
-    glUniform3f(glGetUniformLocation(textShaderProgram, "textColor"), color.x, color.y, color.z);
-    glUniformMatrix4fv(glGetUniformLocation(textShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(textVAO);
+    glState.useProgram(textShaderProgram);
+    textShader.set("textColor", color);
+    textShader.set("projection", projection);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindVertexArray(textVAO);
 
     // Iterate through all characters
     float startX = x;
@@ -288,12 +237,11 @@ void renderText(const std::string& text, float x, float y, float scale, glm::vec
         };
 
         // Render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
+        glState.bindTexture(GL_TEXTURE_2D, ch.TextureID);
 
         // Update content of VBO memory
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+        glState.bindBuffer(GL_ARRAY_BUFFER, textVBO);
         glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
         // Render quad
         glDrawArrays(GL_TRIANGLES, 0, 6);
@@ -301,8 +249,6 @@ void renderText(const std::string& text, float x, float y, float scale, glm::vec
         // Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         startX += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 // Function to invert color
@@ -349,85 +295,27 @@ float NDCToPixel(float ndcValue, bool isRelativeToWidth) {
     }
 }
 
-void drawVerticalLine(float offset, float lineWidth, std::vector<GLfloat> color) {
-    if (color.size() != 4) {
-        throw std::runtime_error("draw line has to have 4 elements");
-    }
-
-    glUseProgram(shaderProgram);
-    glBindVertexArray(VAO);
-    // Set the line color
-    glUniform4f(glGetUniformLocation(shaderProgram, "squareColor"), color[0], color[1], color[2], color[3]);
-
-    // Apply rotation transformation
+// Rotate a point in NDC around the origin by the current coordinate rotation angle
+glm::vec2 rotateCoordinate(float x, float y) {
     float cosTheta = cos(coordinateRotationAngle);
     float sinTheta = sin(coordinateRotationAngle);
-
-    GLfloat model[] = {
-        offset + lineWidth / 2, 1.0f,
-        offset - lineWidth / 2, 1.0f,
-        offset + lineWidth / 2, -1.0f,
-        offset - lineWidth / 2, -1.0f,
-    };
-
-    // Rotate each vertex
-    for (int i = 0; i < 4; i++) {
-        float x = model[i * 2];
-        float y = model[i * 2 + 1];
-        model[i * 2] = x * cosTheta - y * sinTheta; // Rotated x
-        model[i * 2 + 1] = x * sinTheta + y * cosTheta; // Rotated y
-    }
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(model), model, GL_DYNAMIC_DRAW);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-    glBindVertexArray(0);
+    return {x * cosTheta - y * sinTheta, x * sinTheta + y * cosTheta};
 }
 
-void drawHorizontalLine(float offset, float lineWidth, std::vector<GLfloat> color) {
-    if (color.size() != 4) {
-        throw std::runtime_error("draw line has to have 4 elements");
-    }
-
-    glUseProgram(shaderProgram);
-    glBindVertexArray(VAO);
-    // Set the line color
-    glUniform4f(glGetUniformLocation(shaderProgram, "squareColor"), color[0], color[1], color[2], color[3]);
-
-    // Apply rotation transformation
-    float cosTheta = cos(coordinateRotationAngle);
-    float sinTheta = sin(coordinateRotationAngle);
-
-    GLfloat model[] = {
-        1.0f, offset + lineWidth / 2,
-        1.0f, offset - lineWidth / 2,
-        -1.0f, offset + lineWidth / 2,
-        -1.0f, offset - lineWidth / 2,
-    };
-
-    // Rotate each vertex
-    for (int i = 0; i < 4; i++) {
-        float x = model[i * 2];
-        float y = model[i * 2 + 1];
-        model[i * 2] = x * cosTheta - y * sinTheta; // Rotated x
-        model[i * 2 + 1] = x * sinTheta + y * cosTheta; // Rotated y
-    }
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(model), model, GL_DYNAMIC_DRAW);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+// Queue a vertical grid line; lineWidth is in pixels
+void addVerticalLine(float offset, float lineWidth, const glm::vec4& color) {
+    lineRenderer.addLine(rotateCoordinate(offset, 1.0f), rotateCoordinate(offset, -1.0f), lineWidth, color);
+}
 
-    glBindVertexArray(0);
+// Queue a horizontal grid line; lineWidth is in pixels
+void addHorizontalLine(float offset, float lineWidth, const glm::vec4& color) {
+    lineRenderer.addLine(rotateCoordinate(1.0f, offset), rotateCoordinate(-1.0f, offset), lineWidth, color);
 }
 
 void drawCoordinates() {
-    std::vector<GLfloat> lineColor = {0.1f, 0.1f, 0.1f, 1.0f};
-    float boldLineVert = pixelToNDC(2, true);
-    float normalLineVert = pixelToNDC(1, true);
-
-    float boldLineHoriz = pixelToNDC(2, false);
-    float normalLineHoriz = pixelToNDC(1, false);
+    const glm::vec4 lineColor(0.1f, 0.1f, 0.1f, 1.0f);
+    const float boldLineWidth = 2.0f;
+    const float normalLineWidth = 1.0f;
 
     int maxDimension = std::max(windowWidth, windowHeight);
     bool isRelativeToWidth = maxDimension == windowWidth;
@@ -436,14 +324,14 @@ void drawCoordinates() {
     const float pOffset = NDCToPixel(scale / 10.0f, isRelativeToWidth);
     float pPosition = pInitialPosition;
 
-    drawVerticalLine(0, boldLineVert, lineColor); // Central vertical coord line
+    addVerticalLine(0, boldLineWidth, lineColor); // Central vertical coord line
 
     int coordsLabel = 0;
     // Draw vertical lines
     while (pPosition + pOffset <= static_cast<float>(windowWidth)) {
         pPosition += pOffset;
         float position = pixelToNDC(pPosition, isRelativeToWidth) - 1.0f;
-        drawVerticalLine(position, normalLineVert, lineColor);
+        addVerticalLine(position, normalLineWidth, lineColor);
 
         // Calculate rotated text position
         float textX = pPosition;
@@ -466,18 +354,14 @@ void drawCoordinates() {
         float finalX = rotatedX + centerX;
         float finalY = rotatedY + centerY;
 
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        renderText(std::to_string(++coordsLabel), finalX, finalY, 1.0f, glm::vec3(0.1f, 0.1f, 0.1f));
-        glDisable(GL_BLEND);
+        axisLabels.push_back({std::to_string(++coordsLabel), finalX, finalY});
     }
     pPosition = pInitialPosition;
     coordsLabel = 0;
     while (pPosition - pOffset >= 0) {
         pPosition -= pOffset;
         float position = pixelToNDC(pPosition, isRelativeToWidth) - 1.0f;
-        drawVerticalLine(position, normalLineVert, lineColor);
+        addVerticalLine(position, normalLineWidth, lineColor);
 
         // Calculate rotated text position
         float textX = pPosition;
@@ -500,24 +384,20 @@ void drawCoordinates() {
         float finalX = rotatedX + centerX;
         float finalY = rotatedY + centerY;
 
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        renderText(std::to_string(--coordsLabel), finalX, finalY, 1.0f, glm::vec3(0.1f, 0.1f, 0.1f));
-        glDisable(GL_BLEND);
+        axisLabels.push_back({std::to_string(--coordsLabel), finalX, finalY});
     }
 
     pInitialPosition = static_cast<float>(windowHeight) / 2.0f;
     pPosition = pInitialPosition;
     coordsLabel = 0;
 
-    drawHorizontalLine(0, boldLineHoriz, lineColor); // Central horizontal coord line
+    addHorizontalLine(0, boldLineWidth, lineColor); // Central horizontal coord line
 
     // Draw horizontal lines
     while (pPosition + pOffset <= windowHeight) {
         pPosition += pOffset;
         float position = pixelToNDC(pPosition, !isRelativeToWidth) - 1.0f;
-        drawHorizontalLine(position, normalLineHoriz, lineColor);
+        addHorizontalLine(position, normalLineWidth, lineColor);
 
         // Calculate rotated text position
         float textX = windowWidth / 2;
@@ -541,18 +421,14 @@ void drawCoordinates() {
         float finalX = rotatedX + centerX;
         float finalY = rotatedY + centerY;
 
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        renderText(std::to_string(++coordsLabel), finalX, finalY, 1.0f, glm::vec3(0.1f, 0.1f, 0.1f));
-        glDisable(GL_BLEND);
+        axisLabels.push_back({std::to_string(++coordsLabel), finalX, finalY});
     }
     pPosition = pInitialPosition;
     coordsLabel = 0;
     while (pPosition - pOffset >= 0) {
         pPosition -= pOffset;
         float position = pixelToNDC(pPosition, !isRelativeToWidth) - 1.0f;
-        drawHorizontalLine(position, normalLineHoriz, lineColor);
+        addHorizontalLine(position, normalLineWidth, lineColor);
 
         // Calculate rotated text position
         float textX = windowWidth / 2;
@@ -575,32 +451,13 @@ void drawCoordinates() {
         float finalX = rotatedX + centerX;
         float finalY = rotatedY + centerY;
 
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        renderText(std::to_string(--coordsLabel), finalX, finalY, 1.0f, glm::vec3(0.1f, 0.1f, 0.1f));
-        glDisable(GL_BLEND);
+        axisLabels.push_back({std::to_string(--coordsLabel), finalX, finalY});
     }
 }
 
-void drawFunction(float lineWidth, std::vector<GLfloat> color) {
-    if (color.size() != 4) {
-        throw std::runtime_error("draw line has to have 4 elements");
-    }
-
-    // Set the line width
-    glLineWidth(lineWidth);
-
-    // Enable line antialiasing (optional)
-    glEnable(GL_LINE_SMOOTH);
-    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-
-    glUseProgram(shaderProgram);
-    glBindVertexArray(VAO);
-    // Set the line color
-    glUniform4f(glGetUniformLocation(shaderProgram, "squareColor"), color[0], color[1], color[2], color[3]);
-
-    std::vector<GLfloat> model;
+// Queue the function graph as one polyline; lineWidth is in pixels
+void drawFunction(float lineWidth, const glm::vec4& color) {
+    std::vector<glm::vec2> points;
 
     float x = 0.0f;
     float y = 0.0f;
@@ -608,23 +465,19 @@ void drawFunction(float lineWidth, std::vector<GLfloat> color) {
         x = i;
         y = a * x;
 
-        model.push_back(x);
-        model.push_back(y);
+        points.emplace_back(x, y);
     }
 
-    GLfloat modelArray[model.size()];
-    std::copy(model.begin(), model.end(), modelArray);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(modelArray), modelArray, GL_DYNAMIC_DRAW);
-
-    // Use GL_LINE_STRIP to draw a continuous line
-    glDrawArrays(GL_LINE_STRIP, 0, model.size() / 2);
-
-    glBindVertexArray(0);
+    lineRenderer.addPolyline(points, lineWidth, color);
+}
 
-    // Disable line antialiasing (optional)
-    glDisable(GL_LINE_SMOOTH);
+// Render the coordinate labels collected by drawCoordinates on top of the lines
+void drawAxisLabels() {
+    glState.enable(GL_BLEND);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    for (const auto& label : axisLabels) {
+        renderText(label.text, label.x, label.y, 1.0f, glm::vec3(0.1f, 0.1f, 0.1f));
+    }
 }
 
 void handleKeyboardInput(GLFWwindow* window) {
@@ -692,8 +545,15 @@ void mainLoop(GLFWwindow* window) {
 
         handleKeyboardInput(window);
 
+        lineRenderer.clear();
+        axisLabels.clear();
+
         drawCoordinates();
-        drawFunction(50.0f, {1.0f, 0.0f, 0.0f, 1.0f});
+        drawFunction(3.0f, {1.0f, 0.0f, 0.0f, 1.0f});
+
+        // All grid lines and the graph go out in a single draw call
+        lineRenderer.draw(glState, windowWidth, windowHeight);
+        drawAxisLabels();
 
         if (playAnimation) {
             a -= 0.001f;
@@ -717,6 +577,9 @@ int main() {
 
     // Initialize shaders and buffers
     initShadersAndBuffers();
+    if (!lineRenderer.init(programCache)) {
+        return -1;
+    }
 
     // Initialize font for text rendering
     if (!initFont()) {
@@ -726,12 +589,13 @@ int main() {
     // Start the main loop
     mainLoop(window);
 
+    const GLStateCounters& stateCalls = glState.counters();
+    std::cout << "GL state calls: " << stateCalls.issued << " issued, " << stateCalls.elided << " elided" << std::endl;
+
     // Clean up and terminate
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    lineRenderer.destroy();
     glDeleteVertexArrays(1, &textVAO);
     glDeleteBuffers(1, &textVBO);
-    glDeleteProgram(shaderProgram);
     glDeleteProgram(textShaderProgram);
 
     // Clean up character textures
@@ -0,0 +1,167 @@
+#ifndef GLSTATECACHE_H
+#define GLSTATECACHE_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Included after <GL/glew.h> in the GLEW labs, which also enables the core-profile bindings
+#ifndef __glew_h__
+#include <GL/gl.h>
+#endif
+
+// State calls passed on to GL, and calls dropped because they would not have changed anything
+struct GLStateCounters {
+    uint64_t issued = 0;
+    uint64_t elided = 0;
+};
+
+// Shadow copy of the GL state the draw paths set: enable bits, blending, depth, texture
+// bindings and, with GLEW (core-profile labs), the program, vertex array, buffer bindings and
+// active texture unit. A call that would set the value already in place is dropped. Every
+// value starts out unknown, so the first call of each kind always reaches GL. Code that
+// changes tracked state behind the cache (glPopAttrib restoring a bit the cache set,
+// deleting a bound object) has to call invalidate() afterwards.
+class GLStateCache {
+public:
+    GLStateCache() {
+        invalidate();
+    }
+
+    void enable(GLenum capability) {
+        setCapability(capability, true);
+    }
+
+    void disable(GLenum capability) {
+        setCapability(capability, false);
+    }
+
+    void blendFunc(GLenum source, GLenum destination) {
+        if (changes(blendFactors, std::make_pair(source, destination)))
+            glBlendFunc(source, destination);
+    }
+
+    void depthFunc(GLenum function) {
+        if (changes(depthFunction, function))
+            glDepthFunc(function);
+    }
+
+    void depthMask(GLboolean mask) {
+        if (changes(depthWrites, mask))
+            glDepthMask(mask);
+    }
+
+    // Binds on the active texture unit
+    void bindTexture(GLenum target, GLuint texture) {
+        if (!activeUnit.known) {
+            counts.issued++;
+            glBindTexture(target, texture);
+            return;
+        }
+        if (changes(slot(textures, (static_cast<uint64_t>(activeUnit.value) << 32) | target), texture))
+            glBindTexture(target, texture);
+    }
+
+#ifdef __glew_h__
+    void useProgram(GLuint program) {
+        if (changes(currentProgram, program))
+            glUseProgram(program);
+    }
+
+    // The element array binding belongs to the vertex array, so it is forgotten on a switch
+    void bindVertexArray(GLuint vertexArray) {
+        if (changes(currentVertexArray, vertexArray)) {
+            glBindVertexArray(vertexArray);
+            slot(buffers, GL_ELEMENT_ARRAY_BUFFER).known = false;
+        }
+    }
+
+    void bindBuffer(GLenum target, GLuint buffer) {
+        if (changes(slot(buffers, target), buffer))
+            glBindBuffer(target, buffer);
+    }
+
+    void activeTexture(GLenum unit) {
+        if (changes(activeUnit, static_cast<GLuint>(unit - GL_TEXTURE0)))
+            glActiveTexture(unit);
+    }
+#endif
+
+    // Forgets everything; the next call of each kind is issued
+    void invalidate() {
+        capabilities.clear();
+        textures.clear();
+        buffers.clear();
+        blendFactors.known = false;
+        depthFunction.known = false;
+        depthWrites.known = false;
+        currentProgram.known = false;
+        currentVertexArray.known = false;
+#ifdef __glew_h__
+        activeUnit.known = false;
+#else
+        // Without glActiveTexture the unit never changes from GL_TEXTURE0
+        activeUnit = {0, true};
+#endif
+    }
+
+    const GLStateCounters& counters() const {
+        return counts;
+    }
+
+    void resetCounters() {
+        counts = GLStateCounters();
+    }
+
+private:
+    template <typename T>
+    struct Tracked {
+        T value{};
+        bool known = false;
+    };
+
+    // True, and the shadow updated, if setting value is a change that has to reach GL
+    template <typename T>
+    bool changes(Tracked<T>& tracked, const T& value) {
+        if (tracked.known && tracked.value == value) {
+            counts.elided++;
+            return false;
+        }
+        tracked.value = value;
+        tracked.known = true;
+        counts.issued++;
+        return true;
+    }
+
+    // Tracked value for a key in a short list searched linearly; draw paths touch only a few
+    template <typename T>
+    static Tracked<T>& slot(std::vector<std::pair<uint64_t, Tracked<T>>>& list, uint64_t key) {
+        for (auto& entry : list)
+            if (entry.first == key)
+                return entry.second;
+        list.emplace_back(key, Tracked<T>());
+        return list.back().second;
+    }
+
+    void setCapability(GLenum capability, bool enabled) {
+        if (!changes(slot(capabilities, capability), enabled))
+            return;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    std::vector<std::pair<uint64_t, Tracked<bool>>> capabilities;
+    std::vector<std::pair<uint64_t, Tracked<GLuint>>> textures;  // Key: unit << 32 | target
+    std::vector<std::pair<uint64_t, Tracked<GLuint>>> buffers;   // Key: target
+    Tracked<std::pair<GLenum, GLenum>> blendFactors;
+    Tracked<GLenum> depthFunction;
+    Tracked<GLboolean> depthWrites;
+    Tracked<GLuint> currentProgram;
+    Tracked<GLuint> currentVertexArray;
+    Tracked<GLuint> activeUnit;  // Index, 0 for GL_TEXTURE0
+    GLStateCounters counts;
+};
+
+#endif //GLSTATECACHE_H
@@ -0,0 +1,227 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump whenever the file layout changes
+constexpr uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// Cache file layout: this header, then binaryLength bytes from glGetProgramBinary
+struct ProgramCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint64_t key;
+    uint64_t binaryLength;
+};
+
+constexpr char PROGRAM_CACHE_MAGIC[8] = {'S', 'H', 'D', 'R', 'B', 'I', 'N', '\0'};
+static_assert(std::is_trivially_copyable_v<ProgramCacheHeader>, "Header is written and read as raw bytes");
+
+struct ShaderStage {
+    GLenum type;
+    const char* source;
+};
+
+// Directory of linked program binaries. load() hands a program's stored glGetProgramBinary
+// blob back to glProgramBinary, or compiles and links the stages and stores the result. The
+// key hashes every stage's type and source with the driver's vendor, renderer and version
+// strings, so an edited shader or an updated driver never picks up a stale binary; a blob
+// the driver still rejects is compiled again and overwritten.
+class ProgramCache {
+public:
+    explicit ProgramCache(std::string directory) : directory(std::move(directory)) {}
+
+    GLuint load(const std::string& name, std::initializer_list<ShaderStage> stages) const {
+        return load(name, stages.begin(), stages.size());
+    }
+
+    GLuint load(const std::string& name, const ShaderStage* stages, size_t stageCount) const {
+        if (!supported())
+            return compileAndLink(stages, stageCount, false);
+
+        const uint64_t key = programKey(stages, stageCount);
+        const std::filesystem::path path = std::filesystem::path(directory) / fileName(name, key);
+
+        GLuint program = loadBinary(path, key);
+        if (program != 0)
+            return program;
+
+        program = compileAndLink(stages, stageCount, true);
+        storeBinary(program, path, key);
+        return program;
+    }
+
+    // Drivers may support the entry points and still offer no binary format to store
+    static bool supported() {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        return formatCount > 0;
+    }
+
+private:
+    // 64-bit FNV-1a hash of the stages and the driver identification strings
+    static uint64_t programKey(const ShaderStage* stages, size_t stageCount) {
+        uint64_t hash = 14695981039346656037ull;
+        auto addBytes = [&hash](const void* data, size_t size) {
+            const auto* bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        };
+        // Strings are hashed with their terminator so that adjacent ones cannot run together
+        auto addString = [&addBytes](const char* text) {
+            if (text == nullptr)
+                text = "";
+            addBytes(text, std::strlen(text) + 1);
+        };
+
+        addBytes(&PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION));
+        addString(reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+        addString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+        addString(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+        for (size_t s = 0; s < stageCount; s++) {
+            const uint32_t type = stages[s].type;
+            addBytes(&type, sizeof(type));
+            addString(stages[s].source);
+        }
+        return hash;
+    }
+
+    // <name>-<key>.bin
+    static std::string fileName(const std::string& name, uint64_t key) {
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+        return name + "-" + hex + ".bin";
+    }
+
+    // 0 if the file is missing, written for another key, or rejected by the driver
+    static GLuint loadBinary(const std::filesystem::path& path, uint64_t key) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return 0;
+
+        ProgramCacheHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0
+            || header.version != PROGRAM_CACHE_VERSION || header.key != key || header.binaryLength == 0)
+            return 0;
+
+        std::vector<char> binary(header.binaryLength);
+        if (!file.read(binary.data(), static_cast<std::streamsize>(binary.size())))
+            return 0;
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    static GLuint compileAndLink(const ShaderStage* stages, size_t stageCount, bool retrievable) {
+        GLuint program = glCreateProgram();
+        std::vector<GLuint> shaders;
+        for (size_t s = 0; s < stageCount; s++) {
+            GLuint shader = glCreateShader(stages[s].type);
+            glShaderSource(shader, 1, &stages[s].source, nullptr);
+            glCompileShader(shader);
+
+            GLint success;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                char infoLog[512];
+                glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+                std::cerr << "ERROR: Shader compilation failed\n" << infoLog << std::endl;
+            }
+            glAttachShader(program, shader);
+            shaders.push_back(shader);
+        }
+
+        if (retrievable)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+
+        for (GLuint shader : shaders) {
+            glDetachShader(program, shader);
+            glDeleteShader(shader);
+        }
+
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetProgramInfoLog(program, 512, nullptr, infoLog);
+            std::cerr << "ERROR: Shader program linking failed\n" << infoLog << std::endl;
+        }
+        return program;
+    }
+
+    // Only a cleanly linked program is stored; a failed link is compiled again on the next run
+    static void storeBinary(GLuint program, const std::filesystem::path& path, uint64_t key) {
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!success || length <= 0)
+            return;
+
+        ProgramCacheHeader header = {};
+        std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+        header.version = PROGRAM_CACHE_VERSION;
+        header.key = key;
+
+        std::vector<char> data(sizeof(header) + length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &format, data.data() + sizeof(header));
+        if (written <= 0)
+            return;
+        header.binaryFormat = format;
+        header.binaryLength = static_cast<uint64_t>(written);
+        std::memcpy(data.data(), &header, sizeof(header));
+        data.resize(sizeof(header) + written);
+
+        write(path, data);
+    }
+
+    // Written to a temporary file and renamed, so a concurrent reader never loads half a binary
+    static void write(const std::filesystem::path& path, const std::vector<char>& data) {
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+
+        std::filesystem::path temporary = path;
+        temporary += ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!file) {
+                std::cerr << "ERROR: Could not write program cache file " << temporary.string() << std::endl;
+                return;
+            }
+        }
+        std::filesystem::rename(temporary, path, error);
+        if (error)
+            std::cerr << "ERROR: Could not write program cache file " << path.string() << std::endl;
+    }
+
+    std::string directory;
+};
+
+#endif //SHADERCACHE_H
@@ -12,6 +12,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "ShaderCache.h"
+#include "GLStateCache.h"
+#include "ShaderProgram.h"
+
 // Shader sources
 const char* vertexShaderSource = R"(
     #version 410 core
@@ -76,6 +80,8 @@ enum ECorner {
 // Global variables
 GLuint shaderProgram, VAO, VBO;
 GLuint textShaderProgram, textVAO, textVBO;
+ShaderProgram mainShader, textShader; // Reflected uniforms of shaderProgram and textShaderProgram
+GLStateCache glState; // Drops state calls that would not change anything
 float scale = 1.0f;
 int windowWidth, windowHeight;
 float a = 1.0f;
@@ -127,25 +133,16 @@ bool initOpenGL(GLFWwindow*& window) {
 
 // Initialize shaders and buffers
 void initShadersAndBuffers() {
-    // Compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
-
-    // Compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-
-    // Link shaders to a program
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glUseProgram(shaderProgram);
+    // Linked programs are kept as driver binaries in shader_cache/ and reloaded from there on later runs
+    ProgramCache programCache("shader_cache");
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // Compile and link the main program, or load its cached binary
+    shaderProgram = programCache.load("main", {
+        {GL_VERTEX_SHADER, vertexShaderSource},
+        {GL_FRAGMENT_SHADER, fragmentShaderSource},
+    });
+    mainShader.reset(shaderProgram);
+    glUseProgram(shaderProgram);
 
     // Set up vertex data for a square (4 vertices)
     GLfloat vertices[] = {
@@ -168,21 +165,11 @@ void initShadersAndBuffers() {
     glBindVertexArray(0); // Unbind VAO
 
     // Initialize text shaders
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &textVertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
-
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &textFragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-
-    textShaderProgram = glCreateProgram();
-    glAttachShader(textShaderProgram, vertexShader);
-    glAttachShader(textShaderProgram, fragmentShader);
-    glLinkProgram(textShaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    textShaderProgram = programCache.load("text", {
+        {GL_VERTEX_SHADER, textVertexShaderSource},
+        {GL_FRAGMENT_SHADER, textFragmentShaderSource},
+    });
+    textShader.reset(textShaderProgram);
 
     // Initialize text VAO and VBO
     glGenVertexArrays(1, &textVAO);
@@ -274,11 +261,11 @@ bool initFont() {
 // Render a text string
 void renderText(const std::string& text, float x, float y, float scale, glm::vec3 color) {
     // Activate corresponding render state
-    glUseProgram(textShaderProgram);
-    glUniform3f(glGetUniformLocation(textShaderProgram, "textColor"), color.x, color.y, color.z);
-    glUniformMatrix4fv(glGetUniformLocation(textShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(textVAO);
+    glState.useProgram(textShaderProgram);
+    textShader.set("textColor", color);
+    textShader.set("projection", projection);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindVertexArray(textVAO);
 
     // Iterate through all characters
     float startX = x;
@@ -303,12 +290,11 @@ void renderText(const std::string& text, float x, float y, float scale, glm::vec
         };
 
         // Render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
+        glState.bindTexture(GL_TEXTURE_2D, ch.TextureID);
 
         // Update content of VBO memory
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+        glState.bindBuffer(GL_ARRAY_BUFFER, textVBO);
         glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
         // Render quad
         glDrawArrays(GL_TRIANGLES, 0, 6);
@@ -316,8 +302,6 @@ void renderText(const std::string& text, float x, float y, float scale, glm::vec
         // Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         startX += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 // Function to invert color
@@ -380,11 +364,12 @@ void drawSquare(glm::vec2 offset, float squareSize, std::vector<GLfloat> color)
         throw std::runtime_error("draw line has to have 4 elements");
     }
 
-    glUseProgram(shaderProgram);
-    glBindVertexArray(VAO);
+    glState.disable(GL_BLEND);
+    glState.useProgram(shaderProgram);
+    glState.bindVertexArray(VAO);
 
     // Set the square color
-    glUniform4f(glGetUniformLocation(shaderProgram, "squareColor"), color[0], color[1], color[2], color[3]);
+    mainShader.set("squareColor", glm::vec4(color[0], color[1], color[2], color[3]));
 
     float halfSize = squareSize * 0.5f;
 
@@ -428,13 +413,11 @@ void drawSquare(glm::vec2 offset, float squareSize, std::vector<GLfloat> color)
     std::vector<GLfloat> modelArray(model.begin(), model.end());
 
     // Upload the vertex data to the GPU
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, modelArray.size() * sizeof(GLfloat), modelArray.data(), GL_DYNAMIC_DRAW);
 
     // Draw the square
     glDrawArrays(GL_TRIANGLE_STRIP, 0, model.size() / 2);
-
-    glBindVertexArray(0);
 }
 
 void handleKeyboardInput(GLFWwindow* window) {
@@ -543,13 +526,12 @@ void mainLoop(GLFWwindow* window) {
         std::string cornerString = "Current corner: " + std::to_string(currentCorner);
         std::string scaleString = "Scale: " + std::to_string(k);
         std::string increaseString = "Increase: " + std::to_string(increase);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glState.enable(GL_BLEND);
+        glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         renderText(ratioString, NDCToPixel(0.05f, true), NDCToPixel(1.9f, false), 1.5f, {0.0f, 0.5f, 0.5f});
         renderText(cornerString, NDCToPixel(0.05f, true), NDCToPixel(1.8f, false), 1.5f, {0.0f, 0.5f, 0.5f});
         renderText(scaleString, NDCToPixel(0.05f, true), NDCToPixel(1.7f, false), 1.5f, {0.0f, 0.5f, 0.5f});
         renderText(increaseString, NDCToPixel(0.05f, true), NDCToPixel(1.6f, false), 1.5f, {0.0f, 0.5f, 0.5f});
-        glDisable(GL_BLEND);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -577,6 +559,9 @@ int main() {
     // Start the main loop
     mainLoop(window);
 
+    const GLStateCounters& stateCalls = glState.counters();
+    std::cout << "GL state calls: " << stateCalls.issued << " issued, " << stateCalls.elided << " elided" << std::endl;
+
     // Clean up and terminate
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
@@ -0,0 +1,208 @@
+#ifndef BEZIERLOD_H
+#define BEZIERLOD_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <vector>
+#include "BezierTessellator.h"
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "ThreadPool.h"
+
+// Camera parameters for choosing tessellation levels, in the surface's model space
+struct LodView {
+    glm::vec3 eye;
+    float pixelsPerUnit;  // Framebuffer pixels; perspective: per unit at distance 1, orthographic: per unit
+    bool perspective;
+};
+
+// View-dependent tessellation of a trimmed Bezier patch.
+//
+// The patch is split into tilesPerSide x tilesPerSide parameter-space tiles. A tile at
+// level L is a grid of 2^L x 2^L cells, so coarser levels are subsets of finer ones. The
+// level is the lowest one whose projected geometric error stays under tolerancePixels:
+// the deviation of the tile from its bilinear corner quad is measured once, and it falls
+// by 4x per level since the interpolation error of a smooth surface is quadratic in the
+// cell size. Tiles next to a coarser neighbour snap their shared edge onto the
+// neighbour's polyline (EdgeStitching), so level changes never open cracks.
+//
+// update() picks levels every frame; when they change, the mesh is rebuilt on a private
+// worker thread, run through the mesh optimizer and split into meshlets there, and picked
+// up with takeMesh() once it is ready.
+class AdaptiveBezierSurface {
+public:
+    AdaptiveBezierSurface(const BezierSurface& surface, const DiamondTrim& trim, int tilesPerSide = 4,
+                          int maxLevel = 6, float tolerancePixels = 0.5f)
+        : surface(surface), trim(trim), tilesPerSide(tilesPerSide), maxLevel(maxLevel),
+          tolerancePixels(tolerancePixels) {
+        const float tileSize = 1.0f / tilesPerSide;
+        for (int ti = 0; ti < tilesPerSide; ti++) {
+            for (int tj = 0; tj < tilesPerSide; tj++) {
+                Tile tile;
+                tile.u0 = ti * tileSize;
+                tile.u1 = ti + 1 == tilesPerSide ? 1.0f : (ti + 1) * tileSize;
+                tile.v0 = tj * tileSize;
+                tile.v1 = tj + 1 == tilesPerSide ? 1.0f : (tj + 1) * tileSize;
+                measureTile(tile);
+                tiles.push_back(tile);
+            }
+        }
+    }
+
+    // Level of every tile (row-major, u first) for the given view
+    std::vector<int> selectLevels(const LodView& view) const {
+        std::vector<int> levels(tiles.size());
+        for (size_t t = 0; t < tiles.size(); t++) {
+            const Tile& tile = tiles[t];
+
+            float pixelsPerUnit = view.pixelsPerUnit;
+            if (view.perspective) {
+                const float distance = glm::length(view.eye - tile.center) - tile.radius;
+                pixelsPerUnit /= std::max(distance, 1e-3f);
+            }
+
+            // Smallest level with flatness / 4^level * pixelsPerUnit <= tolerance
+            const float errorPixels = tile.flatness * pixelsPerUnit;
+            int level = 0;
+            if (errorPixels > tolerancePixels)
+                level = static_cast<int>(std::ceil(0.5f * std::log2(errorPixels / tolerancePixels)));
+            levels[t] = std::clamp(level, 0, maxLevel);
+        }
+        return levels;
+    }
+
+    // Tessellate all tiles at the given levels into one vertex/index buffer
+    void tessellate(const std::vector<int>& levels, std::vector<float>& vertices,
+                    std::vector<unsigned int>& indices) const {
+        vertices.clear();
+        indices.clear();
+
+        for (int ti = 0; ti < tilesPerSide; ti++) {
+            for (int tj = 0; tj < tilesPerSide; tj++) {
+                const Tile& tile = tiles[ti * tilesPerSide + tj];
+                const int level = levels[ti * tilesPerSide + tj];
+
+                // Stitch every side whose neighbour is coarser
+                EdgeStitching stitching;
+                auto stitch = [&](int side, int ni, int nj) {
+                    if (ni < 0 || ni >= tilesPerSide || nj < 0 || nj >= tilesPerSide)
+                        return;
+                    const int neighbourLevel = levels[ni * tilesPerSide + nj];
+                    if (neighbourLevel < level)
+                        stitching.segments[side] = 1 << neighbourLevel;
+                };
+                stitch(EdgeStitching::U_BEGIN, ti - 1, tj);
+                stitch(EdgeStitching::U_END, ti + 1, tj);
+                stitch(EdgeStitching::V_BEGIN, ti, tj - 1);
+                stitch(EdgeStitching::V_END, ti, tj + 1);
+
+                const int samples = (1 << level) + 1;
+                const std::vector<float> uParams = trimAwareSamples(tile.u0, tile.u1, samples, trim.centerU);
+                const std::vector<float> vParams = trimAwareSamples(tile.v0, tile.v1, samples, trim.centerV);
+                tessellateTrimmedGrid(surface, trim, uParams, vParams, vertices, indices, stitching);
+            }
+        }
+    }
+
+    // Choose levels for the view and start a rebuild if they changed and none is running
+    void update(const LodView& view) {
+        std::vector<int> levels = selectLevels(view);
+        if (levels == requestedLevels || busy.load())
+            return;
+
+        requestedLevels = levels;
+        busy = true;
+        worker.submit([this, levels = std::move(levels)] {
+            std::vector<float> newVertices;
+            std::vector<unsigned int> newIndices;
+            tessellate(levels, newVertices, newIndices);
+            optimizeMesh(newVertices, 6, newIndices);
+            std::vector<Meshlet> newMeshlets = buildMeshlets(newIndices, newVertices, 6);
+            optimizeVertexFetch(newVertices, 6, newIndices);
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            readyVertices = std::move(newVertices);
+            readyIndices = std::move(newIndices);
+            readyMeshlets = std::move(newMeshlets);
+            resultReady = true;
+            busy = false;
+        });
+    }
+
+    // Move out the most recent finished mesh; false when nothing new is ready
+    bool takeMesh(std::vector<float>& vertices, std::vector<unsigned int>& indices, std::vector<Meshlet>& meshlets) {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        if (!resultReady)
+            return false;
+        vertices = std::move(readyVertices);
+        indices = std::move(readyIndices);
+        meshlets = std::move(readyMeshlets);
+        resultReady = false;
+        return true;
+    }
+
+private:
+    struct Tile {
+        float u0, u1, v0, v1;
+        glm::vec3 center;
+        float radius;
+        float flatness;  // Largest distance between the tile and its bilinear corner quad
+    };
+
+    void measureTile(Tile& tile) const {
+        constexpr int SAMPLES = 9;
+        glm::vec3 points[SAMPLES][SAMPLES];
+        glm::vec3 low(1e30f), high(-1e30f);
+
+        for (int a = 0; a < SAMPLES; a++) {
+            for (int b = 0; b < SAMPLES; b++) {
+                const float u = tile.u0 + (tile.u1 - tile.u0) * a / (SAMPLES - 1);
+                const float v = tile.v0 + (tile.v1 - tile.v0) * b / (SAMPLES - 1);
+                points[a][b] = surface.evaluate(u, v);
+                low = glm::min(low, points[a][b]);
+                high = glm::max(high, points[a][b]);
+            }
+        }
+
+        tile.center = 0.5f * (low + high);
+        tile.radius = 0.0f;
+        tile.flatness = 0.0f;
+
+        const glm::vec3& p00 = points[0][0];
+        const glm::vec3& p10 = points[SAMPLES - 1][0];
+        const glm::vec3& p01 = points[0][SAMPLES - 1];
+        const glm::vec3& p11 = points[SAMPLES - 1][SAMPLES - 1];
+        for (int a = 0; a < SAMPLES; a++) {
+            for (int b = 0; b < SAMPLES; b++) {
+                const float s = static_cast<float>(a) / (SAMPLES - 1);
+                const float t = static_cast<float>(b) / (SAMPLES - 1);
+                const glm::vec3 bilinear = glm::mix(glm::mix(p00, p01, t), glm::mix(p10, p11, t), s);
+                tile.flatness = std::max(tile.flatness, glm::length(points[a][b] - bilinear));
+                tile.radius = std::max(tile.radius, glm::length(points[a][b] - tile.center));
+            }
+        }
+    }
+
+    BezierSurface surface;
+    DiamondTrim trim;
+    int tilesPerSide;
+    int maxLevel;
+    float tolerancePixels;
+    std::vector<Tile> tiles;
+
+    std::vector<int> requestedLevels;
+    std::atomic<bool> busy{false};
+
+    std::mutex resultMutex;
+    bool resultReady = false;
+    std::vector<float> readyVertices;
+    std::vector<unsigned int> readyIndices;
+    std::vector<Meshlet> readyMeshlets;
+
+    // Declared last: destroyed first, so a running rebuild finishes while the members above still exist
+    ThreadPool worker{1};
+};
+
+#endif //BEZIERLOD_H
@@ -0,0 +1,274 @@
+#ifndef BEZIERPATCHRENDERER_H
+#define BEZIERPATCHRENDERER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "BezierTessellator.h"
+#include "ShaderCache.h"
+#include "ShaderProgram.h"
+#include "UniformRing.h"
+
+// Draws a trimmed bicubic Bezier patch with the GL 4 tessellation stages. Only the 16
+// control points are uploaded; the control shader sets per-edge tessellation levels from
+// the projected length of each boundary's control polygon, the evaluation shader evaluates
+// position and analytic normal from the Bernstein basis, and the fragment shader discards
+// the trimmed diamond in parameter space, so the hole outline is exact per pixel.
+class BezierPatchRenderer {
+public:
+    float pixelsPerSegment = 8.0f;  // Target length of one tessellated edge segment in framebuffer pixels
+
+    // Needs a GL 4.0+ context (or ARB_tessellation_shader)
+    static bool isSupported() {
+        GLint major = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        return major >= 4 || GLEW_ARB_tessellation_shader;
+    }
+
+    // The program is loaded through programCache like the scene programs; it has the most
+    // stages in the lab and gains the most from skipping the compile on later runs
+    bool init(const ProgramCache& programCache, const BezierSurface& surface, const DiamondTrim& patchTrim) {
+        trim = patchTrim;
+
+        program = programCache.load("patch", {
+            {GL_VERTEX_SHADER, patchVertexShaderSource},
+            {GL_TESS_CONTROL_SHADER, patchControlShaderSource},
+            {GL_TESS_EVALUATION_SHADER, patchEvaluationShaderSource},
+            {GL_FRAGMENT_SHADER, patchFragmentShaderSource},
+        });
+
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+            return false;
+        bindUniformBlock(program, "Frame", FRAME_BLOCK_BINDING);
+        bindUniformBlock(program, "Object", OBJECT_BLOCK_BINDING);
+        uniforms.reset(program);
+
+        // Control points in row-major order, first index along u
+        glm::vec3 points[16];
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                points[i * 4 + j] = surface.controlPoint(i, j);
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(points), points, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return true;
+    }
+
+    // Camera, light, model and colour come from the Frame and Object blocks bound at
+    // FRAME_BLOCK_BINDING and OBJECT_BLOCK_BINDING, as for the scene shaders
+    void draw() {
+        uniforms.use();
+        uniforms.set("pixelsPerSegment", pixelsPerSegment);
+        uniforms.set("trimDiamond", glm::vec3(trim.centerU, trim.centerV, trim.radius));
+
+        glBindVertexArray(vao);
+        glPatchParameteri(GL_PATCH_VERTICES, 16);
+        glDrawArrays(GL_PATCHES, 0, 16);
+        glBindVertexArray(0);
+    }
+
+    void destroy() {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteProgram(program);
+    }
+
+private:
+    static constexpr const char* patchVertexShaderSource = R"(
+        #version 410 core
+        layout (location = 0) in vec3 aPos;
+
+        void main() {
+            gl_Position = vec4(aPos, 1.0);
+        }
+    )";
+
+    static constexpr const char* patchControlShaderSource = R"(
+        #version 410 core
+        layout (vertices = 16) out;
+
+        // FrameUniforms and ObjectUniforms (UniformRing.h)
+        layout (std140) uniform Frame {
+            mat4 view;
+            mat4 projection;
+            mat4 viewProjection;
+            vec4 viewPos;
+            vec4 lightPos[4];  // MAX_SCENE_LIGHTS; the patch is lit by the first
+            vec4 lightColor[4];
+            vec4 wireframeStyle;
+            vec4 fogStyle;
+            vec2 viewportSize;
+        };
+
+        layout (std140) uniform Object {
+            mat4 model;
+            mat3 normalMatrix;  // Inverse transpose of the model matrix, computed on the CPU
+            vec3 objectColor;
+        };
+
+        uniform float pixelsPerSegment;
+
+        vec2 toScreen(int index) {
+            vec4 clip = viewProjection * model * gl_in[index].gl_Position;
+            return clip.xy / max(clip.w, 0.01) * 0.5 * viewportSize;
+        }
+
+        // Projected length of a boundary's control polygon bounds the length of the curve
+        float edgeLevel(int a, int b, int c, int d) {
+            vec2 pa = toScreen(a), pb = toScreen(b), pc = toScreen(c), pd = toScreen(d);
+            float pixels = length(pb - pa) + length(pc - pb) + length(pd - pc);
+            return clamp(pixels / pixelsPerSegment, 1.0, 64.0);
+        }
+
+        void main() {
+            gl_out[gl_InvocationID].gl_Position = gl_in[gl_InvocationID].gl_Position;
+
+            if (gl_InvocationID == 0) {
+                // Control point index = 4 * (u index) + (v index)
+                gl_TessLevelOuter[0] = edgeLevel(0, 1, 2, 3);     // u = 0
+                gl_TessLevelOuter[1] = edgeLevel(0, 4, 8, 12);    // v = 0
+                gl_TessLevelOuter[2] = edgeLevel(12, 13, 14, 15); // u = 1
+                gl_TessLevelOuter[3] = edgeLevel(3, 7, 11, 15);   // v = 1
+                gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+                gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+            }
+        }
+    )";
+
+    static constexpr const char* patchEvaluationShaderSource = R"(
+        #version 410 core
+        layout (quads, fractional_odd_spacing, ccw) in;
+
+        // FrameUniforms and ObjectUniforms (UniformRing.h)
+        layout (std140) uniform Frame {
+            mat4 view;
+            mat4 projection;
+            mat4 viewProjection;
+            vec4 viewPos;
+            vec4 lightPos[4];  // MAX_SCENE_LIGHTS; the patch is lit by the first
+            vec4 lightColor[4];
+            vec4 wireframeStyle;
+            vec4 fogStyle;
+            vec2 viewportSize;
+        };
+
+        layout (std140) uniform Object {
+            mat4 model;
+            mat3 normalMatrix;  // Inverse transpose of the model matrix, computed on the CPU
+            vec3 objectColor;
+        };
+
+        out vec3 FragPos;
+        out vec3 Normal;
+        out vec2 PatchCoord;
+
+        void bernstein(float t, out vec4 basis, out vec4 derivative) {
+            float s = 1.0 - t;
+            basis = vec4(s * s * s, 3.0 * s * s * t, 3.0 * s * t * t, t * t * t);
+            derivative = vec4(-3.0 * s * s, 3.0 * s * (s - 2.0 * t), 3.0 * t * (2.0 * s - t), 3.0 * t * t);
+        }
+
+        void main() {
+            float u = gl_TessCoord.x;
+            float v = gl_TessCoord.y;
+
+            vec4 bu, du, bv, dv;
+            bernstein(u, bu, du);
+            bernstein(v, bv, dv);
+
+            // Contract along v per control row, then along u; derivatives from the same rows
+            vec3 position = vec3(0.0), tangentU = vec3(0.0), tangentV = vec3(0.0);
+            for (int i = 0; i < 4; i++) {
+                vec3 row = vec3(0.0), rowDv = vec3(0.0);
+                for (int j = 0; j < 4; j++) {
+                    vec3 point = gl_in[i * 4 + j].gl_Position.xyz;
+                    row += bv[j] * point;
+                    rowDv += dv[j] * point;
+                }
+                position += bu[i] * row;
+                tangentU += du[i] * row;
+                tangentV += bu[i] * rowDv;
+            }
+
+            vec3 normal = cross(tangentU, tangentV);
+            normal = length(normal) > 1e-10 ? normalize(normal) : vec3(0.0, 1.0, 0.0);
+
+            PatchCoord = vec2(u, v);
+            FragPos = vec3(model * vec4(position, 1.0));
+            Normal = normalMatrix * normal;
+            gl_Position = viewProjection * vec4(FragPos, 1.0);
+        }
+    )";
+
+    static constexpr const char* patchFragmentShaderSource = R"(
+        #version 410 core
+        out vec4 FragColor;
+
+        in vec3 FragPos;
+        in vec3 Normal;
+        in vec2 PatchCoord;
+
+        // FrameUniforms and ObjectUniforms (UniformRing.h)
+        layout (std140) uniform Frame {
+            mat4 view;
+            mat4 projection;
+            mat4 viewProjection;
+            vec4 viewPos;
+            vec4 lightPos[4];  // MAX_SCENE_LIGHTS; the patch is lit by the first
+            vec4 lightColor[4];
+            vec4 wireframeStyle;
+            vec4 fogStyle;
+            vec2 viewportSize;
+        };
+
+        layout (std140) uniform Object {
+            mat4 model;
+            mat3 normalMatrix;  // Inverse transpose of the model matrix, computed on the CPU
+            vec3 objectColor;
+        };
+
+        uniform vec3 trimDiamond;  // centerU, centerV, radius
+
+        void main() {
+            // Trim: cut away |u - centerU| + |v - centerV| < radius
+            if (abs(PatchCoord.x - trimDiamond.x) + abs(PatchCoord.y - trimDiamond.y) < trimDiamond.z)
+                discard;
+
+            // Ambient lighting
+            float ambientStrength = 0.1;
+            vec3 ambient = ambientStrength * lightColor[0].rgb;
+
+            // Diffuse lighting
+            vec3 norm = normalize(Normal);
+            vec3 lightDir = normalize(lightPos[0].xyz - FragPos);
+            float diff = max(dot(norm, lightDir), 0.0);
+            vec3 diffuse = diff * lightColor[0].rgb;
+
+            // Specular lighting
+            float specularStrength = 0.5;
+            vec3 viewDir = normalize(viewPos.xyz - FragPos);
+            vec3 reflectDir = reflect(-lightDir, norm);
+            float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+            vec3 specular = specularStrength * spec * lightColor[0].rgb;
+
+            vec3 result = (ambient + diffuse + specular) * objectColor;
+            FragColor = vec4(result, 1.0);
+        }
+    )";
+
+    DiamondTrim trim;
+    GLuint program = 0, vao = 0, vbo = 0;
+    ShaderProgram uniforms;
+};
+
+#endif //BEZIERPATCHRENDERER_H
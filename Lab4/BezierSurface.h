@@ -0,0 +1,541 @@
+#ifndef BEZIERSURFACE_H
+#define BEZIERSURFACE_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Binomial coefficient C(n, k); constexpr, so basis coefficients are folded at compile time
+constexpr int binomialCoef(int n, int k) {
+    if (k < 0 || k > n)
+        return 0;
+
+    // C(n,k) = C(n,n-k)
+    if (k > n - k)
+        k = n - k;
+
+    int result = 1;
+    for (int i = 0; i < k; ++i) {
+        result *= (n - i);
+        result /= (i + 1);
+    }
+    return result;
+}
+
+// C(N, 0) .. C(N, N)
+template <int N>
+constexpr std::array<float, N + 1> binomialRow() {
+    std::array<float, N + 1> row{};
+    for (int k = 0; k <= N; k++)
+        row[k] = static_cast<float>(binomialCoef(N, k));
+    return row;
+}
+
+// body(std::integral_constant<int, K>()) for K = 0 .. Count - 1, expanded in place
+template <int Count, typename Body>
+inline void unrolledFor(Body&& body) {
+    [&]<int... K>(std::integer_sequence<int, K...>) {
+        (body(std::integral_constant<int, K>()), ...);
+    }(std::make_integer_sequence<int, Count>());
+}
+
+// term(0) + term(1) + ... + term(Count - 1), expanded in place
+template <int Count, typename Term>
+inline auto unrolledSum(Term&& term) {
+    return [&]<int... K>(std::integer_sequence<int, K...>) {
+        return (term(K) + ...);
+    }(std::make_integer_sequence<int, Count>());
+}
+
+// Span of `spans` equal spans over [0, 1] that contains param, and param local to that span
+inline int locateSpan(float param, int spans, float& local) {
+    const float scaled = std::clamp(param, 0.0f, 1.0f) * spans;
+    const int span = std::min(static_cast<int>(scaled), spans - 1);
+    local = scaled - span;
+    return span;
+}
+
+// Bernstein basis of degree Degree on one span. Consecutive spans of a piecewise Bezier
+// curve share their end control point, so span s is shaped by control points
+// s * Degree .. s * Degree + Degree.
+template <int Degree>
+struct BernsteinBasis {
+    static constexpr int DEGREE = Degree;
+    static constexpr int ORDER = Degree + 1;
+
+    static constexpr int controlCount(int spans) {
+        return spans * Degree + 1;
+    }
+
+    static constexpr int firstControl(int span) {
+        return span * Degree;
+    }
+
+    // B_k(t) = C(n, k) t^k (1 - t)^(n - k)
+    static void evaluate(float t, float (&b)[ORDER]) {
+        constexpr auto coefficients = binomialRow<Degree>();
+        float tPower[ORDER], sPower[ORDER];
+        powers(t, tPower);
+        powers(1.0f - t, sPower);
+        unrolledFor<ORDER>([&](auto k) {
+            b[k] = coefficients[k] * tPower[k] * sPower[Degree - k];
+        });
+    }
+
+    // dB_k/dt = n (B_{k-1,n-1}(t) - B_{k,n-1}(t))
+    static void derivative(float t, float (&d)[ORDER]) {
+        if constexpr (Degree == 0) {
+            d[0] = 0.0f;
+        } else {
+            constexpr auto coefficients = binomialRow<Degree - 1>();
+            float tPower[ORDER], sPower[ORDER];
+            powers(t, tPower);
+            powers(1.0f - t, sPower);
+
+            float lower[Degree];
+            unrolledFor<Degree>([&](auto k) {
+                lower[k] = coefficients[k] * tPower[k] * sPower[Degree - 1 - k];
+            });
+            unrolledFor<ORDER>([&](auto k) {
+                constexpr int K = decltype(k)::value;
+                float value = 0.0f;
+                if constexpr (K > 0)
+                    value += lower[K - 1];
+                if constexpr (K < Degree)
+                    value -= lower[K];
+                d[K] = Degree * value;
+            });
+        }
+    }
+
+private:
+    static void powers(float x, float (&p)[ORDER]) {
+        p[0] = 1.0f;
+        unrolledFor<Degree>([&](auto k) {
+            p[k + 1] = p[k] * x;
+        });
+    }
+};
+
+// Uniform B-spline basis of degree Degree on one knot span, with t local to the span. With
+// unit knot spacing every span uses the same polynomials, span s is shaped by control
+// points s .. s + Degree, and neighbouring spans join with Degree - 1 continuous derivatives.
+template <int Degree>
+struct UniformBSplineBasis {
+    static constexpr int DEGREE = Degree;
+    static constexpr int ORDER = Degree + 1;
+
+    static constexpr int controlCount(int spans) {
+        return spans + Degree;
+    }
+
+    static constexpr int firstControl(int span) {
+        return span;
+    }
+
+    static void evaluate(float t, float (&b)[ORDER]) {
+        coxDeBoor<Degree>(t, b);
+    }
+
+    // With unit knot spacing, dN_{k,p}/dt = N_{k,p-1}(t) - N_{k+1,p-1}(t)
+    static void derivative(float t, float (&d)[ORDER]) {
+        if constexpr (Degree == 0) {
+            d[0] = 0.0f;
+        } else {
+            float lower[ORDER];
+            coxDeBoor<Degree - 1>(t, lower);
+            unrolledFor<ORDER>([&](auto k) {
+                constexpr int K = decltype(k)::value;
+                float value = 0.0f;
+                if constexpr (K > 0)
+                    value += lower[K - 1];
+                if constexpr (K < Degree)
+                    value -= lower[K];
+                d[K] = value;
+            });
+        }
+    }
+
+private:
+    // Cox-de Boor recursion for the Upto + 1 functions of degree Upto that are nonzero on the
+    // span. With unit knot spacing the denominator of every step of degree j is j.
+    template <int Upto>
+    static void coxDeBoor(float t, float (&b)[ORDER]) {
+        b[0] = 1.0f;
+        unrolledFor<Upto>([&](auto step) {
+            constexpr int J = decltype(step)::value + 1;
+            constexpr float inverseJ = 1.0f / J;
+            float saved = 0.0f;
+            unrolledFor<J>([&](auto r) {
+                constexpr int R = decltype(r)::value;
+                const float temp = b[R] * inverseJ;
+                b[R] = saved + (R + 1 - t) * temp;
+                saved = (t + (J - R - 1)) * temp;
+            });
+            b[J] = saved;
+        });
+    }
+};
+
+// Basis values and their derivatives at a fixed set of parameters in [0, 1], stored as one
+// array per basis function so that evaluation loops read them with unit stride. The
+// parameters are split over `spans` equal spans; derivatives are with respect to the global
+// parameter, and consecutive parameters in the same span are grouped into runs.
+template <typename Basis>
+struct BasisTable {
+    static constexpr int ORDER = Basis::ORDER;
+
+    struct Run {
+        int begin, end;    // Parameter indices
+        int firstControl;  // First control point of the span
+    };
+
+    std::vector<float> basis[ORDER];
+    std::vector<float> derivative[ORDER];
+    std::vector<int> firstControl;
+    std::vector<Run> runs;
+
+    BasisTable() = default;
+
+    // count parameters spaced uniformly over [0, 1]
+    explicit BasisTable(int count, int spans = 1) {
+        const float step = count > 1 ? 1.0f / (count - 1) : 0.0f;
+        resize(count);
+        for (int k = 0; k < count; k++)
+            set(k, k * step, spans);
+    }
+
+    explicit BasisTable(const std::vector<float>& params, int spans = 1) {
+        resize(static_cast<int>(params.size()));
+        for (int k = 0; k < size(); k++)
+            set(k, params[k], spans);
+    }
+
+    int size() const {
+        return static_cast<int>(firstControl.size());
+    }
+
+private:
+    void resize(int count) {
+        for (int i = 0; i < ORDER; i++) {
+            basis[i].resize(count);
+            derivative[i].resize(count);
+        }
+        firstControl.resize(count);
+    }
+
+    void set(int k, float param, int spans) {
+        float local;
+        const int first = Basis::firstControl(locateSpan(param, spans, local));
+
+        float b[ORDER], d[ORDER];
+        Basis::evaluate(local, b);
+        Basis::derivative(local, d);
+        for (int i = 0; i < ORDER; i++) {
+            basis[i][k] = b[i];
+            derivative[i][k] = d[i] * spans;
+        }
+
+        firstControl[k] = first;
+        if (!runs.empty() && runs.back().firstControl == first && runs.back().end == k)
+            runs.back().end = k + 1;
+        else
+            runs.push_back({k, k + 1, first});
+    }
+};
+
+// One evaluated row of a surface grid in structure-of-arrays layout
+struct SurfaceRow {
+    std::vector<float> x, y, z;
+    std::vector<float> nx, ny, nz;
+    std::vector<float> dvx, dvy, dvz;  // Scratch: dS/dv before the cross product
+    std::vector<float> w, wu, wv;      // Scratch for rational surfaces: weight and its derivatives
+
+    // Scratch: homogeneous control points of the row's curve in v, and of its u derivative
+    std::vector<glm::vec4> curve, curveDu;
+
+    explicit SurfaceRow(int count = 0) {
+        resize(count);
+    }
+
+    void resize(int count) {
+        for (auto* column : {&x, &y, &z, &nx, &ny, &nz, &dvx, &dvy, &dvz, &w, &wu, &wv})
+            column->resize(count);
+    }
+};
+
+// Tensor-product surface over [0, 1] x [0, 1], made of spansU x spansV polynomial spans.
+// BasisU and BasisV fix the degree and the kind of spans at compile time (BernsteinBasis:
+// piecewise Bezier, UniformBSplineBasis: uniform B-spline). A Rational surface carries a
+// weight per control point, which covers rational Bezier patches and NURBS with uniform
+// knots. Control point (i, j) is the i-th along u and the j-th along v.
+//
+// A grid is evaluated row by row: the control net is first contracted with the u basis of
+// the row into the control points of one curve in v, and that curve is then evaluated for
+// the whole row at once from the v table, one run of same-span parameters at a time. The
+// row loop is a plain multiply-add over float arrays with the basis sums unrolled for the
+// degree, which the compiler vectorizes on every target.
+//
+// Normals come from the analytic partial derivatives in the same sweep: dS/du uses the
+// curve contracted with the u derivative basis, dS/dv the v derivative table.
+template <typename BasisU, typename BasisV, bool Rational = false>
+class TensorSurface {
+public:
+    static constexpr int ORDER_U = BasisU::ORDER;
+    static constexpr int ORDER_V = BasisV::ORDER;
+
+    using UTable = BasisTable<BasisU>;
+    using VTable = BasisTable<BasisV>;
+
+    // A single span each way from a fixed control net, e.g. a plain Bezier patch
+    template <int RowsU, int RowsV>
+    explicit TensorSurface(const glm::vec3 (&points)[RowsU][RowsV]) : spanCountU(1), spanCountV(1) {
+        static_assert(RowsU == BasisU::controlCount(1) && RowsV == BasisV::controlCount(1),
+                      "Control net does not match the surface degree");
+        for (int i = 0; i < RowsU; i++)
+            for (int j = 0; j < RowsV; j++)
+                net.emplace_back(points[i][j], 1.0f);
+    }
+
+    // spansU x spansV spans; points row by row with the u index first. Weights are only used
+    // by rational surfaces, and an empty list means that all of them are 1.
+    TensorSurface(int spansU, int spansV, const std::vector<glm::vec3>& points,
+                  const std::vector<float>& weights = {})
+        : spanCountU(std::max(spansU, 1)), spanCountV(std::max(spansV, 1)) {
+        const size_t count = static_cast<size_t>(controlCountU()) * controlCountV();
+        if (points.size() != count || (!weights.empty() && weights.size() != count))
+            std::cerr << "ERROR: Surface needs " << count << " control points for "
+                      << spanCountU << "x" << spanCountV << " spans" << std::endl;
+
+        net.resize(count, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        for (size_t k = 0; k < std::min(count, points.size()); k++) {
+            const float weight = Rational && k < weights.size() ? weights[k] : 1.0f;
+            net[k] = glm::vec4(points[k] * weight, weight);
+        }
+    }
+
+    int spansU() const {
+        return spanCountU;
+    }
+
+    int spansV() const {
+        return spanCountV;
+    }
+
+    int controlCountU() const {
+        return BasisU::controlCount(spanCountU);
+    }
+
+    int controlCountV() const {
+        return BasisV::controlCount(spanCountV);
+    }
+
+    glm::vec3 controlPoint(int i, int j) const {
+        const glm::vec4& point = control(i, j);
+        return glm::vec3(point) / point.w;
+    }
+
+    float weight(int i, int j) const {
+        return control(i, j).w;
+    }
+
+    // Basis tables for a grid of parameters along u and along v
+    UTable makeUTable(const std::vector<float>& params) const {
+        return UTable(params, spanCountU);
+    }
+
+    VTable makeVTable(const std::vector<float>& params) const {
+        return VTable(params, spanCountV);
+    }
+
+    // Points and unit normals (dS/du x dS/dv) at u = uTable parameter ui and every v of vTable
+    void evaluateRow(const UTable& uTable, int ui, const VTable& vTable, SurfaceRow& row) const {
+        const int count = vTable.size();
+        row.resize(count);
+        row.curve.resize(controlCountV());
+        row.curveDu.resize(controlCountV());
+
+        contractU(uTable.basis, uTable.firstControl[ui], ui, row.curve.data());
+        contractU(uTable.derivative, uTable.firstControl[ui], ui, row.curveDu.data());
+
+        for (const auto& run : vTable.runs) {
+            const glm::vec4* curve = row.curve.data() + run.firstControl;
+            const glm::vec4* curveDu = row.curveDu.data() + run.firstControl;
+
+            evaluateCurve(curve, vTable.basis, run.begin, run.end,
+                          row.x.data(), row.y.data(), row.z.data(), row.w.data());
+
+            // dS/du is kept in the normal columns until the cross product
+            evaluateCurve(curveDu, vTable.basis, run.begin, run.end,
+                          row.nx.data(), row.ny.data(), row.nz.data(), row.wu.data());
+            evaluateCurve(curve, vTable.derivative, run.begin, run.end,
+                          row.dvx.data(), row.dvy.data(), row.dvz.data(), row.wv.data());
+        }
+
+        if constexpr (Rational) {
+            // S = A / w. The tangents A' - w' S are the true ones scaled by 1 / w > 0, which
+            // leaves the normal's direction unchanged
+            for (int j = 0; j < count; j++) {
+                const float inverseW = 1.0f / row.w[j];
+                row.x[j] *= inverseW;
+                row.y[j] *= inverseW;
+                row.z[j] *= inverseW;
+                row.nx[j] -= row.wu[j] * row.x[j];
+                row.ny[j] -= row.wu[j] * row.y[j];
+                row.nz[j] -= row.wu[j] * row.z[j];
+                row.dvx[j] -= row.wv[j] * row.x[j];
+                row.dvy[j] -= row.wv[j] * row.y[j];
+                row.dvz[j] -= row.wv[j] * row.z[j];
+            }
+        }
+
+        for (int j = 0; j < count; j++) {
+            const float ux = row.nx[j], uy = row.ny[j], uz = row.nz[j];
+            float nx = uy * row.dvz[j] - uz * row.dvy[j];
+            float ny = uz * row.dvx[j] - ux * row.dvz[j];
+            float nz = ux * row.dvy[j] - uy * row.dvx[j];
+
+            // Degenerate parameterization (collapsed edge): fall back to up
+            const float lengthSq = nx * nx + ny * ny + nz * nz;
+            const bool degenerate = lengthSq < 1e-20f;
+            const float invLength = degenerate ? 0.0f : 1.0f / std::sqrt(lengthSq);
+            row.nx[j] = degenerate ? 0.0f : nx * invLength;
+            row.ny[j] = degenerate ? 1.0f : ny * invLength;
+            row.nz[j] = degenerate ? 0.0f : nz * invLength;
+        }
+    }
+
+    glm::vec3 evaluate(float u, float v) const {
+        float localU, localV;
+        const int firstU = BasisU::firstControl(locateSpan(u, spanCountU, localU));
+        const int firstV = BasisV::firstControl(locateSpan(v, spanCountV, localV));
+
+        float bu[ORDER_U], bv[ORDER_V];
+        BasisU::evaluate(localU, bu);
+        BasisV::evaluate(localV, bv);
+
+        const glm::vec4 point = unrolledSum<ORDER_U>([&](int ki) {
+            return bu[ki] * unrolledSum<ORDER_V>([&](int kj) {
+                return bv[kj] * control(firstU + ki, firstV + kj);
+            });
+        });
+        return Rational ? glm::vec3(point) / point.w : glm::vec3(point);
+    }
+
+    // Partial derivatives dS/du and dS/dv at (u, v)
+    void evaluateDerivatives(float u, float v, glm::vec3& du, glm::vec3& dv) const {
+        float localU, localV;
+        const int firstU = BasisU::firstControl(locateSpan(u, spanCountU, localU));
+        const int firstV = BasisV::firstControl(locateSpan(v, spanCountV, localV));
+
+        float bu[ORDER_U], bv[ORDER_V], du4[ORDER_U], dv4[ORDER_V];
+        BasisU::evaluate(localU, bu);
+        BasisV::evaluate(localV, bv);
+        BasisU::derivative(localU, du4);
+        BasisV::derivative(localV, dv4);
+
+        glm::vec4 point(0.0f), pointDu(0.0f), pointDv(0.0f);
+        for (int ki = 0; ki < ORDER_U; ki++) {
+            for (int kj = 0; kj < ORDER_V; kj++) {
+                const glm::vec4& p = control(firstU + ki, firstV + kj);
+                point += p * (bu[ki] * bv[kj]);
+                pointDu += p * (du4[ki] * bv[kj]);
+                pointDv += p * (bu[ki] * dv4[kj]);
+            }
+        }
+        pointDu *= static_cast<float>(spanCountU);
+        pointDv *= static_cast<float>(spanCountV);
+
+        if constexpr (Rational) {
+            // Quotient rule: S' = (A' - w' S) / w
+            const glm::vec3 position = glm::vec3(point) / point.w;
+            du = (glm::vec3(pointDu) - pointDu.w * position) / point.w;
+            dv = (glm::vec3(pointDv) - pointDv.w * position) / point.w;
+        } else {
+            du = glm::vec3(pointDu);
+            dv = glm::vec3(pointDv);
+        }
+    }
+
+    glm::vec3 normal(float u, float v) const {
+        glm::vec3 du, dv;
+        evaluateDerivatives(u, v, du, dv);
+        const glm::vec3 n = glm::cross(du, dv);
+        const float length = glm::length(n);
+        return length > 1e-10f ? n / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+private:
+    const glm::vec4& control(int i, int j) const {
+        return net[i * controlCountV() + j];
+    }
+
+    // Homogeneous control points of the whole v-curve at u = parameter ui of a u table
+    // (uBasis = its basis or derivative), whose span starts at control row firstU
+    void contractU(const std::vector<float> (&uBasis)[ORDER_U], int firstU, int ui, glm::vec4* curve) const {
+        float b[ORDER_U];
+        for (int k = 0; k < ORDER_U; k++)
+            b[k] = uBasis[k][ui];
+
+        const int columns = controlCountV();
+        const glm::vec4* rows = net.data() + firstU * columns;
+        for (int j = 0; j < columns; j++)
+            curve[j] = unrolledSum<ORDER_U>([&](int k) { return rows[k * columns + j] * b[k]; });
+    }
+
+    // Evaluates one span of a v-curve (its ORDER_V homogeneous control points start at
+    // `curve`) at parameters [begin, end) of a v table (vBasis = its basis or derivative)
+    static void evaluateCurve(const glm::vec4* curve, const std::vector<float> (&vBasis)[ORDER_V], int begin, int end,
+                              float* xs, float* ys, float* zs, float* ws) {
+        const float* b[ORDER_V];
+        float cx[ORDER_V], cy[ORDER_V], cz[ORDER_V], cw[ORDER_V];
+        for (int k = 0; k < ORDER_V; k++) {
+            b[k] = vBasis[k].data();
+            cx[k] = curve[k].x;
+            cy[k] = curve[k].y;
+            cz[k] = curve[k].z;
+            cw[k] = curve[k].w;
+        }
+
+        for (int j = begin; j < end; j++)
+            xs[j] = unrolledSum<ORDER_V>([&](int k) { return b[k][j] * cx[k]; });
+        for (int j = begin; j < end; j++)
+            ys[j] = unrolledSum<ORDER_V>([&](int k) { return b[k][j] * cy[k]; });
+        for (int j = begin; j < end; j++)
+            zs[j] = unrolledSum<ORDER_V>([&](int k) { return b[k][j] * cz[k]; });
+        if constexpr (Rational) {
+            for (int j = begin; j < end; j++)
+                ws[j] = unrolledSum<ORDER_V>([&](int k) { return b[k][j] * cw[k]; });
+        }
+    }
+
+    int spanCountU, spanCountV;
+    std::vector<glm::vec4> net;  // Homogeneous control points (w * position, w), row-major along u
+};
+
+// Bicubic Bezier patch, the plane's surface
+using BezierSurface = TensorSurface<BernsteinBasis<3>, BernsteinBasis<3>>;
+
+template <int DegreeU, int DegreeV>
+using RationalBezierSurface = TensorSurface<BernsteinBasis<DegreeU>, BernsteinBasis<DegreeV>, true>;
+
+template <int DegreeU, int DegreeV>
+using UniformBSplineSurface = TensorSurface<UniformBSplineBasis<DegreeU>, UniformBSplineBasis<DegreeV>>;
+
+template <int DegreeU, int DegreeV>
+using UniformNurbsSurface = TensorSurface<UniformBSplineBasis<DegreeU>, UniformBSplineBasis<DegreeV>, true>;
+
+// Point at t on the Bezier curve with the given control points, of any degree
+template <int Count>
+glm::vec3 bezierPoint(float t, const glm::vec3 (&points)[Count]) {
+    float b[Count];
+    BernsteinBasis<Count - 1>::evaluate(t, b);
+    return unrolledSum<Count>([&](int k) { return b[k] * points[k]; });
+}
+
+#endif //BEZIERSURFACE_H
@@ -0,0 +1,323 @@
+#ifndef BEZIERTESSELLATOR_H
+#define BEZIERTESSELLATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "BezierSurface.h"
+#include "ThreadPool.h"
+
+// Diamond-shaped trim region in parameter space: |u - centerU| + |v - centerV| < radius is
+// cut away. value() is positive on the kept side and linear inside any grid cell that does
+// not cross the kink lines u = centerU or v = centerV.
+struct DiamondTrim {
+    float centerU = 0.5f;
+    float centerV = 0.5f;
+    float radius = 0.0f;
+
+    float value(float u, float v) const {
+        const float distance = std::fabs(u - centerU) + std::fabs(v - centerV) - radius;
+        // Samples that should sit exactly on the outline (e.g. 8 * 0.05 = 0.4) are snapped onto
+        // it, instead of producing a crossing vertex a rounding error away from the sample
+        return std::fabs(distance) < 1e-6f ? 0.0f : distance;
+    }
+};
+
+// count samples spaced uniformly over [begin, end], plus `kink` when it falls strictly inside
+// and is not already a sample, so that a piecewise-linear trim stays linear per cell.
+inline std::vector<float> trimAwareSamples(float begin, float end, int count, float kink) {
+    std::vector<float> samples(count);
+    const float step = (end - begin) / (count - 1);
+    for (int k = 0; k < count; k++)
+        samples[k] = begin + k * step;
+    samples[count - 1] = end;
+
+    const float epsilon = 1e-6f * (end - begin);
+    if (kink > begin + epsilon && kink < end - epsilon) {
+        auto position = std::lower_bound(samples.begin(), samples.end(), kink);
+        const bool present = std::fabs(*position - kink) <= epsilon
+                          || std::fabs(*(position - 1) - kink) <= epsilon;
+        if (!present)
+            samples.insert(position, kink);
+    }
+    return samples;
+}
+
+// Resolution of the neighbours around a grid, for crack-free joins between tessellation levels:
+// the number of uniform segments the neighbour uses along each side, 0 when the neighbour is
+// not coarser and the side needs no stitching
+struct EdgeStitching {
+    enum Side { U_BEGIN = 0, U_END = 1, V_BEGIN = 2, V_END = 3 };
+    int segments[4] = {0, 0, 0, 0};
+};
+
+// Point at parameter s on the polyline a coarser neighbour uses along a grid side: the
+// iso-line u = fixed (alongV) or v = fixed, split into `segments` uniform segments between
+// s0 and s1, with the same kink and trim-crossing vertices the neighbour inserts.
+template <typename Surface>
+glm::vec3 coarseEdgePoint(const Surface& surface, const DiamondTrim& trim, bool alongV,
+                                 float fixed, float s0, float s1, int segments, float s) {
+    auto pointAt = [&](float t) {
+        return alongV ? surface.evaluate(fixed, t) : surface.evaluate(t, fixed);
+    };
+    auto trimAt = [&](float t) {
+        return alongV ? trim.value(fixed, t) : trim.value(t, fixed);
+    };
+
+    const std::vector<float> samples = trimAwareSamples(s0, s1, segments + 1, alongV ? trim.centerV : trim.centerU);
+    auto upper = std::upper_bound(samples.begin(), samples.end(), s);
+    if (upper == samples.begin())
+        return pointAt(s0);
+    if (upper == samples.end())
+        return pointAt(s1);
+
+    float a = *(upper - 1);
+    float b = *upper;
+
+    // A trim crossing splits the coarse segment; s lies on the kept part
+    const float trimA = trimAt(a);
+    const float trimB = trimAt(b);
+    if ((trimA < 0.0f && trimB > 0.0f) || (trimA > 0.0f && trimB < 0.0f)) {
+        const float c = a + (b - a) * trimA / (trimA - trimB);
+        if (s <= c)
+            b = c;
+        else
+            a = c;
+    }
+
+    const float t = b > a ? (s - a) / (b - a) : 0.0f;
+    return glm::mix(pointAt(a), pointAt(b), t);
+}
+
+// Tessellates the grid uParams x vParams of a surface (any TensorSurface), trimmed by a diamond.
+//
+// Grid points on the kept side become vertices; every grid edge crossed by the trim gets
+// one extra vertex at the exact crossing, evaluated on the surface at its parameters and
+// shared by both cells on the edge. Each cell is clipped against the trim (a convex
+// polygon of at most five corners) and fan-triangulated, so the hole outline follows the
+// trim curve exactly instead of the grid staircase.
+//
+// Vertices are appended as position + normal (6 floats) and indices refer to them, so
+// several calls can be concatenated into one buffer. All passes run on bands of rows with
+// per-row prefix sums, so the output does not depend on the number of threads.
+//
+// Vertices on a side listed in `stitching` are moved onto the coarser neighbour's edge
+// polyline, so a grid can sit next to one of a lower level without cracks.
+template <typename Surface>
+void tessellateTrimmedGrid(const Surface& surface, const DiamondTrim& trim,
+                           const std::vector<float>& uParams, const std::vector<float>& vParams,
+                           std::vector<float>& vertices, std::vector<unsigned int>& indices,
+                           const EdgeStitching& stitching = EdgeStitching()) {
+    const int rows = static_cast<int>(uParams.size());
+    const int columns = static_cast<int>(vParams.size());
+    if (rows < 2 || columns < 2)
+        return;
+
+    const typename Surface::UTable uTable = surface.makeUTable(uParams);
+    const typename Surface::VTable vTable = surface.makeVTable(vParams);
+    ThreadPool& pool = ThreadPool::shared();
+
+    // Grid points, trim values, and per-edge crossing parameters (t along the edge, < 0 = no crossing)
+    std::vector<glm::vec3> gridPoints(rows * columns);
+    std::vector<glm::vec3> gridNormals(rows * columns);
+    std::vector<float> trimValues(rows * columns);
+    std::vector<float> rowEdgeCrossing(rows * (columns - 1));     // (i, j) - (i, j + 1)
+    std::vector<float> columnEdgeCrossing((rows - 1) * columns);  // (i, j) - (i + 1, j)
+
+    pool.parallelFor(rows, [&](int rowBegin, int rowEnd) {
+        SurfaceRow row(columns);
+        for (int i = rowBegin; i < rowEnd; i++) {
+            surface.evaluateRow(uTable, i, vTable, row);
+            for (int j = 0; j < columns; j++) {
+                const int idx = i * columns + j;
+                gridPoints[idx] = glm::vec3(row.x[j], row.y[j], row.z[j]);
+                gridNormals[idx] = glm::vec3(row.nx[j], row.ny[j], row.nz[j]);
+                trimValues[idx] = trim.value(uParams[i], vParams[j]);
+            }
+        }
+    });
+
+    // Crossing parameter of an edge whose ends have trim values a and b; a value of exactly
+    // zero is a kept point on the outline and needs no extra vertex
+    auto crossing = [](float a, float b) {
+        return ((a < 0.0f && b > 0.0f) || (a > 0.0f && b < 0.0f)) ? a / (a - b) : -1.0f;
+    };
+
+    // First pass: count the vertices of every row (kept grid points plus the crossings on
+    // the row's own edges and on the edges down to the next row) and prefix-sum the counts
+    std::vector<int> rowOffsets(rows + 1, 0);
+
+    pool.parallelFor(rows, [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            int rowCount = 0;
+            for (int j = 0; j < columns; j++) {
+                const int idx = i * columns + j;
+                rowCount += trimValues[idx] >= 0.0f ? 1 : 0;
+
+                if (j + 1 < columns) {
+                    const float t = crossing(trimValues[idx], trimValues[idx + 1]);
+                    rowEdgeCrossing[i * (columns - 1) + j] = t;
+                    rowCount += t >= 0.0f ? 1 : 0;
+                }
+                if (i + 1 < rows) {
+                    const float t = crossing(trimValues[idx], trimValues[idx + columns]);
+                    columnEdgeCrossing[idx] = t;
+                    rowCount += t >= 0.0f ? 1 : 0;
+                }
+            }
+            rowOffsets[i + 1] = rowCount;
+        }
+    });
+    for (int i = 0; i < rows; i++)
+        rowOffsets[i + 1] += rowOffsets[i];
+
+    // Second pass: write the vertices and fill the dense index images (-1 = no vertex)
+    const auto baseVertex = static_cast<int32_t>(vertices.size() / 6);
+    const size_t firstFloat = vertices.size();
+    vertices.resize(firstFloat + static_cast<size_t>(rowOffsets[rows]) * 6);
+
+    std::vector<int32_t> gridIndex(rows * columns);
+    std::vector<int32_t> rowEdgeIndex(rows * (columns - 1));
+    std::vector<int32_t> columnEdgeIndex((rows - 1) * columns);
+
+    pool.parallelFor(rows, [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            int32_t next = rowOffsets[i];
+
+            // sides: bit mask of the EdgeStitching sides the vertex lies on
+            auto emit = [&](float u, float v, int sides, glm::vec3 position, const glm::vec3& normal) {
+                for (int side = 0; side < 4; side++) {
+                    const int segments = stitching.segments[side];
+                    if (!(sides & (1 << side)) || segments <= 0)
+                        continue;
+                    if (side == EdgeStitching::U_BEGIN || side == EdgeStitching::U_END)
+                        position = coarseEdgePoint(surface, trim, true, u, vParams.front(), vParams.back(), segments, v);
+                    else
+                        position = coarseEdgePoint(surface, trim, false, v, uParams.front(), uParams.back(), segments, u);
+                }
+
+                float* out = vertices.data() + firstFloat + static_cast<size_t>(next) * 6;
+                out[0] = position.x;
+                out[1] = position.y;
+                out[2] = position.z;
+                out[3] = normal.x;
+                out[4] = normal.y;
+                out[5] = normal.z;
+                return baseVertex + next++;
+            };
+
+            const int rowSides = (i == 0 ? 1 << EdgeStitching::U_BEGIN : 0)
+                               | (i == rows - 1 ? 1 << EdgeStitching::U_END : 0);
+
+            for (int j = 0; j < columns; j++) {
+                const int idx = i * columns + j;
+                const int columnSides = (j == 0 ? 1 << EdgeStitching::V_BEGIN : 0)
+                                      | (j == columns - 1 ? 1 << EdgeStitching::V_END : 0);
+
+                gridIndex[idx] = trimValues[idx] >= 0.0f
+                    ? emit(uParams[i], vParams[j], rowSides | columnSides, gridPoints[idx], gridNormals[idx])
+                    : -1;
+
+                if (j + 1 < columns) {
+                    const int edge = i * (columns - 1) + j;
+                    const float t = rowEdgeCrossing[edge];
+                    if (t >= 0.0f) {
+                        const float v = vParams[j] + (vParams[j + 1] - vParams[j]) * t;
+                        rowEdgeIndex[edge] = emit(uParams[i], v, rowSides, surface.evaluate(uParams[i], v), surface.normal(uParams[i], v));
+                    } else {
+                        rowEdgeIndex[edge] = -1;
+                    }
+                }
+                if (i + 1 < rows) {
+                    const float t = columnEdgeCrossing[idx];
+                    if (t >= 0.0f) {
+                        const float u = uParams[i] + (uParams[i + 1] - uParams[i]) * t;
+                        columnEdgeIndex[idx] = emit(u, vParams[j], columnSides, surface.evaluate(u, vParams[j]), surface.normal(u, vParams[j]));
+                    } else {
+                        columnEdgeIndex[idx] = -1;
+                    }
+                }
+            }
+        }
+    });
+
+    // Third pass: clip every cell against the trim and triangulate what is left. Every cell
+    // row writes its own index list; the lists are concatenated in row order afterwards.
+    std::vector<std::vector<unsigned int>> rowIndices(rows - 1);
+
+    pool.parallelFor(rows - 1, [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            std::vector<unsigned int>& rowOut = rowIndices[i];
+
+            for (int j = 0; j < columns - 1; j++) {
+                const int v00 = gridIndex[i * columns + j];
+                const int v10 = gridIndex[(i + 1) * columns + j];
+                const int v11 = gridIndex[(i + 1) * columns + j + 1];
+                const int v01 = gridIndex[i * columns + j + 1];
+
+                if (v00 >= 0 && v10 >= 0 && v11 >= 0 && v01 >= 0) {
+                    // Untrimmed cell: standard quad triangulation
+                    rowOut.insert(rowOut.end(), {
+                        static_cast<unsigned int>(v00), static_cast<unsigned int>(v10), static_cast<unsigned int>(v01),
+                        static_cast<unsigned int>(v01), static_cast<unsigned int>(v10), static_cast<unsigned int>(v11)
+                    });
+                    continue;
+                }
+
+                // Walk the cell boundary (00 -> 10 -> 11 -> 01), keeping corners and crossings
+                const int corners[4] = {v00, v10, v11, v01};
+                const glm::vec2 cornerParams[4] = {
+                    {uParams[i], vParams[j]}, {uParams[i + 1], vParams[j]},
+                    {uParams[i + 1], vParams[j + 1]}, {uParams[i], vParams[j + 1]}
+                };
+                const int edges[4] = {
+                    columnEdgeIndex[i * columns + j],           // 00 - 10
+                    rowEdgeIndex[(i + 1) * (columns - 1) + j],  // 10 - 11
+                    columnEdgeIndex[i * columns + j + 1],       // 11 - 01
+                    rowEdgeIndex[i * (columns - 1) + j]         // 01 - 00
+                };
+
+                int polygon[8];
+                glm::vec2 polygonParams[8];
+                int polygonSize = 0;
+                for (int k = 0; k < 4; k++) {
+                    const int kNext = (k + 1) % 4;
+                    if (corners[k] >= 0) {
+                        polygonParams[polygonSize] = cornerParams[k];
+                        polygon[polygonSize++] = corners[k];
+                    }
+                    if (edges[k] >= 0) {
+                        const float a = trim.value(cornerParams[k].x, cornerParams[k].y);
+                        const float b = trim.value(cornerParams[kNext].x, cornerParams[kNext].y);
+                        polygonParams[polygonSize] = glm::mix(cornerParams[k], cornerParams[kNext], a / (a - b));
+                        polygon[polygonSize++] = edges[k];
+                    }
+                }
+
+                // The clipped cell is convex: fan from its first corner. Corners lying exactly on
+                // the trim can make fan triangles collinear; those are skipped.
+                for (int k = 1; k + 1 < polygonSize; k++) {
+                    const glm::vec2 e1 = polygonParams[k] - polygonParams[0];
+                    const glm::vec2 e2 = polygonParams[k + 1] - polygonParams[0];
+                    const glm::vec2 cell = cornerParams[2] - cornerParams[0];
+                    if (e1.x * e2.y - e1.y * e2.x <= 1e-6f * cell.x * cell.y)
+                        continue;
+
+                    rowOut.push_back(polygon[0]);
+                    rowOut.push_back(polygon[k]);
+                    rowOut.push_back(polygon[k + 1]);
+                }
+            }
+        }
+    });
+
+    size_t indexCount = indices.size();
+    for (const auto& rowOut : rowIndices)
+        indexCount += rowOut.size();
+    indices.reserve(indexCount);
+    for (const auto& rowOut : rowIndices)
+        indices.insert(indices.end(), rowOut.begin(), rowOut.end());
+}
+
+#endif //BEZIERTESSELLATOR_H
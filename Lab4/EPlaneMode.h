@@ -0,0 +1,12 @@
+#ifndef EPLANEMODE_H
+#define EPLANEMODE_H
+
+// How the Bezier plane is tessellated
+enum class EPlaneMode {
+    FixedGrid = 0,  // generateBezierPlane at a fixed resolution, built once
+    Adaptive = 1,   // View-dependent tiles (AdaptiveBezierSurface), rebuilt as the camera moves
+    Hardware = 2,   // Tessellation shaders from the 16 control points (BezierPatchRenderer)
+    Sculpt = 3,     // Editable C1 multi-patch surface (MultiPatchSurface), updated patch by patch
+};
+
+#endif //EPLANEMODE_H
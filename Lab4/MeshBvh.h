@@ -0,0 +1,607 @@
+#ifndef MESHBVH_H
+#define MESHBVH_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <vector>
+#include "ThreadPool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MESHBVH_SSE 1
+#endif
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;  // Need not be unit length; hit distances are in multiples of it
+};
+
+struct RayHit {
+    float distance = std::numeric_limits<float>::infinity();
+    uint32_t triangle = 0;  // Index into the mesh's triangle list (indices / 3)
+    float u = 0.0f, v = 0.0f;  // Barycentric weights of the triangle's second and third corner
+};
+
+// Closest point to p on the triangle abc (Ericson, "Real-Time Collision Detection", 5.1.5)
+inline glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+        return a;
+
+    const glm::vec3 bp = p - b;
+    const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+        return b;
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return a + ab * (d1 / (d1 - d3));
+
+    const glm::vec3 cp = p - c;
+    const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+        return c;
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return a + ac * (d2 / (d2 - d6));
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    const float denominator = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Bounding volume hierarchy over the triangles of an indexed mesh, for ray picking and
+// collision queries.
+//
+// build() splits with the surface area heuristic evaluated over BVH_BINS centroid bins
+// along the longest axis of the centroid bounds. The top of the tree is split on the calling thread until there are enough
+// independent ranges, which are then built in parallel into private node arrays and
+// appended in order, so the result does not depend on scheduling. The binary tree is
+// collapsed into a 4-wide one whose child boxes are stored as structure of arrays, so a
+// ray is tested against all four with a handful of SSE instructions.
+//
+// refit() takes moved vertex positions (same indices) and recomputes the boxes bottom-up
+// without changing the tree; queries stay exact, but large deformations make the tree
+// slower until the next build().
+class MeshBvh {
+public:
+    static constexpr int BVH_BINS = 16;
+    static constexpr uint32_t MAX_LEAF_TRIANGLES = 8;
+
+    void build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& meshIndices,
+               ThreadPool& pool = ThreadPool::shared()) {
+        indices = meshIndices;
+        const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        nodes.clear();
+        triangleOrder.clear();
+        triangles.clear();
+        if (triangleCount == 0)
+            return;
+
+        BuildInput input;
+        input.boxes.resize(triangleCount);
+        input.centroids.resize(triangleCount);
+        input.order.resize(triangleCount);
+        Range root = {0, triangleCount, emptyBox(), emptyBox()};
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            const glm::vec3& a = positions[indices[t * 3]];
+            const glm::vec3& b = positions[indices[t * 3 + 1]];
+            const glm::vec3& c = positions[indices[t * 3 + 2]];
+            input.boxes[t] = {glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c))};
+            input.centroids[t] = (a + b + c) / 3.0f;
+            input.order[t] = t;
+            grow(root.box, input.boxes[t]);
+            grow(root.centroids, {input.centroids[t], input.centroids[t]});
+        }
+
+        // Split the top serially until every range that is still large has a task of its own
+        std::vector<BuildNode> binary(1);
+        std::vector<Pending> pending = {{0, root}};
+        const size_t targetTasks = static_cast<size_t>(pool.threadCount() + 1) * 4;
+        for (size_t next = 0; next < pending.size() && pending.size() < targetTasks;) {
+            const Pending top = pending[next];
+            Range left, right;
+            if (top.range.end - top.range.begin < PARALLEL_MIN_TRIANGLES || !splitRange(input, top.range, left, right)) {
+                next++;
+                continue;
+            }
+            const uint32_t child = static_cast<uint32_t>(binary.size());
+            binary[top.node] = {top.range.box, child, top.range.begin, 0};
+            binary.resize(binary.size() + 2);
+            pending.erase(pending.begin() + next);
+            pending.push_back({child, left});
+            pending.push_back({child + 1, right});
+        }
+
+        std::vector<std::vector<BuildNode>> subtrees(pending.size());
+        pool.parallelFor(static_cast<int>(pending.size()), [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                subtrees[i].emplace_back();
+                buildSubtree(input, subtrees[i], 0, pending[i].range);
+            }
+        }, 1);
+
+        // A pending node is replaced by its subtree's root; the rest is appended with shifted links
+        for (size_t i = 0; i < pending.size(); i++) {
+            const uint32_t offset = static_cast<uint32_t>(binary.size()) - 1;
+            std::vector<BuildNode>& subtree = subtrees[i];
+            for (BuildNode& node : subtree) {
+                if (node.count == 0)
+                    node.left += offset;
+            }
+            binary[pending[i].node] = subtree[0];
+            binary.insert(binary.end(), subtree.begin() + 1, subtree.end());
+        }
+
+        triangleOrder = std::move(input.order);
+        nodes.emplace_back();
+        uint32_t depth = 0;
+        collapse(binary, 0, 0, 0, depth);
+        // A node at depth d is visited with at most three pending siblings per level above it
+        // and pushes up to four children
+        stackCapacity = 3 * depth + 4;
+        refit(positions);
+    }
+
+    // Recomputes triangle data and boxes for moved vertices; the indices must be unchanged
+    void refit(const std::vector<glm::vec3>& positions) {
+        triangles.resize(triangleOrder.size());
+        for (size_t i = 0; i < triangleOrder.size(); i++) {
+            const uint32_t t = triangleOrder[i];
+            const glm::vec3& a = positions[indices[t * 3]];
+            triangles[i] = {a, positions[indices[t * 3 + 1]] - a, positions[indices[t * 3 + 2]] - a};
+        }
+
+        // Children always come after their parent, so a reverse sweep sees them first
+        for (size_t n = nodes.size(); n-- > 0;) {
+            Node& node = nodes[n];
+            for (int slot = 0; slot < 4; slot++) {
+                if (node.child[slot] == EMPTY)
+                    continue;
+                glm::vec3 low(std::numeric_limits<float>::infinity()), high(-std::numeric_limits<float>::infinity());
+                if (node.count[slot] > 0) {
+                    for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++) {
+                        const Triangle& triangle = triangles[i];
+                        const glm::vec3 b = triangle.v0 + triangle.e1, c = triangle.v0 + triangle.e2;
+                        low = glm::min(low, glm::min(triangle.v0, glm::min(b, c)));
+                        high = glm::max(high, glm::max(triangle.v0, glm::max(b, c)));
+                    }
+                } else {
+                    const Node& child = nodes[node.child[slot]];
+                    for (int childSlot = 0; childSlot < 4; childSlot++) {
+                        if (child.child[childSlot] == EMPTY)
+                            continue;
+                        low = glm::min(low, glm::vec3(child.minX[childSlot], child.minY[childSlot], child.minZ[childSlot]));
+                        high = glm::max(high, glm::vec3(child.maxX[childSlot], child.maxY[childSlot], child.maxZ[childSlot]));
+                    }
+                }
+                node.minX[slot] = low.x;
+                node.minY[slot] = low.y;
+                node.minZ[slot] = low.z;
+                node.maxX[slot] = high.x;
+                node.maxY[slot] = high.y;
+                node.maxZ[slot] = high.z;
+            }
+        }
+    }
+
+    bool empty() const {
+        return nodes.empty();
+    }
+
+    // Closest hit with distance below hit.distance
+    bool intersect(const Ray& ray, RayHit& hit) const {
+        return traverse<false>(ray, hit);
+    }
+
+    // Any hit closer than maxDistance, for occlusion and line-of-sight tests
+    bool intersectAny(const Ray& ray, float maxDistance = std::numeric_limits<float>::infinity()) const {
+        RayHit hit;
+        hit.distance = maxDistance;
+        return traverse<true>(ray, hit);
+    }
+
+    bool overlapsSphere(const glm::vec3& center, float radius) const {
+        return overlapSphere<true>(center, radius, nullptr);
+    }
+
+    // Appends every triangle that touches the sphere
+    void overlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const {
+        overlapSphere<false>(center, radius, &result);
+    }
+
+private:
+    static constexpr uint32_t EMPTY = ~0u;
+    static constexpr uint32_t PARALLEL_MIN_TRIANGLES = 4096;
+    static constexpr uint32_t STACK_SIZE = 256;  // Traversal stack kept on the call stack
+
+    struct Box {
+        glm::vec3 low, high;
+    };
+
+    struct BuildInput {
+        std::vector<Box> boxes;
+        std::vector<glm::vec3> centroids;
+        std::vector<uint32_t> order;
+    };
+
+    // Leaf when count > 0 (triangles order[first, first + count)), else children left, left + 1
+    struct BuildNode {
+        Box box;
+        uint32_t left = 0;
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    // Triangles order[begin, end) with the bounds of their boxes and of their centroids
+    struct Range {
+        uint32_t begin, end;
+        Box box, centroids;
+    };
+
+    struct Pending {
+        uint32_t node;
+        Range range;
+    };
+
+    // Four child boxes as structure of arrays. A child is a leaf with count triangles starting
+    // at child, an inner node at nodes[child] when count is 0, or unused when child is EMPTY.
+    struct alignas(16) Node {
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        uint32_t child[4];
+        uint32_t count[4];
+    };
+
+    // First corner and the two edges from it, in tree order
+    struct Triangle {
+        glm::vec3 v0, e1, e2;
+    };
+
+    static float surfaceArea(const Box& box) {
+        const glm::vec3 size = glm::max(box.high - box.low, glm::vec3(0.0f));
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    static Box emptyBox() {
+        return {glm::vec3(std::numeric_limits<float>::infinity()), glm::vec3(-std::numeric_limits<float>::infinity())};
+    }
+
+    static void grow(Box& box, const Box& other) {
+        box.low = glm::min(box.low, other.low);
+        box.high = glm::max(box.high, other.high);
+    }
+
+    // Splits range by the cheapest binned SAH plane along the longest centroid axis and
+    // returns true with both halves and their bounds, read off the bins without another
+    // pass; returns false when the range should stay a leaf
+    static bool splitRange(BuildInput& input, const Range& range, Range& left, Range& right) {
+        const uint32_t count = range.end - range.begin;
+        if (count <= 2)
+            return false;
+
+        const glm::vec3 extents = range.centroids.high - range.centroids.low;
+        const int axis = extents.x >= extents.y && extents.x >= extents.z ? 0 : (extents.y >= extents.z ? 1 : 2);
+        const float extent = extents[axis];
+        if (!(extent > 0.0f)) {
+            if (count <= MAX_LEAF_TRIANGLES)
+                return false;
+
+            // Coincident centroids: halve the range so leaves stay small
+            const uint32_t middle = range.begin + count / 2;
+            left = {range.begin, middle, emptyBox(), range.centroids};
+            right = {middle, range.end, emptyBox(), range.centroids};
+            for (uint32_t i = range.begin; i < range.end; i++)
+                grow(i < middle ? left.box : right.box, input.boxes[input.order[i]]);
+            return true;
+        }
+
+        Box binBoxes[BVH_BINS], binCentroids[BVH_BINS];
+        uint32_t binCounts[BVH_BINS] = {};
+        for (int bin = 0; bin < BVH_BINS; bin++)
+            binBoxes[bin] = binCentroids[bin] = emptyBox();
+        const float low = range.centroids.low[axis];
+        const float scale = BVH_BINS / extent;
+        auto binOf = [&](uint32_t t) {
+            return std::min(BVH_BINS - 1, static_cast<int>((input.centroids[t][axis] - low) * scale));
+        };
+        for (uint32_t i = range.begin; i < range.end; i++) {
+            const uint32_t t = input.order[i];
+            const int bin = binOf(t);
+            binCounts[bin]++;
+            grow(binBoxes[bin], input.boxes[t]);
+            grow(binCentroids[bin], {input.centroids[t], input.centroids[t]});
+        }
+
+        // Area and count of everything right of each plane, then sweep from the left.
+        // Costs are relative to one triangle test, with a traversal step as expensive as one.
+        float rightArea[BVH_BINS];
+        uint32_t rightCount[BVH_BINS];
+        Box sweep = emptyBox();
+        uint32_t sum = 0;
+        for (int bin = BVH_BINS - 1; bin > 0; bin--) {
+            grow(sweep, binBoxes[bin]);
+            sum += binCounts[bin];
+            rightArea[bin] = surfaceArea(sweep);
+            rightCount[bin] = sum;
+        }
+        float bestCost = std::numeric_limits<float>::infinity();
+        int bestBin = 0;
+        const float parentArea = surfaceArea(range.box);
+        sweep = emptyBox();
+        sum = 0;
+        for (int bin = 1; bin < BVH_BINS; bin++) {
+            grow(sweep, binBoxes[bin - 1]);
+            sum += binCounts[bin - 1];
+            if (sum == 0 || rightCount[bin] == 0)
+                continue;
+            const float cost = 1.0f + (surfaceArea(sweep) * sum + rightArea[bin] * rightCount[bin]) / parentArea;
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestBin = bin;
+            }
+        }
+        if (count <= MAX_LEAF_TRIANGLES && bestCost >= static_cast<float>(count))
+            return false;
+
+        const uint32_t* middle = std::partition(input.order.data() + range.begin, input.order.data() + range.end,
+                                                [&](uint32_t t) { return binOf(t) < bestBin; });
+        left = {range.begin, static_cast<uint32_t>(middle - input.order.data()), emptyBox(), emptyBox()};
+        right = {left.end, range.end, emptyBox(), emptyBox()};
+        for (int bin = 0; bin < BVH_BINS; bin++) {
+            Range& side = bin < bestBin ? left : right;
+            grow(side.box, binBoxes[bin]);
+            grow(side.centroids, binCentroids[bin]);
+        }
+        return true;
+    }
+
+    static void buildSubtree(BuildInput& input, std::vector<BuildNode>& tree, uint32_t node, const Range& range) {
+        tree[node] = {range.box, 0, range.begin, range.end - range.begin};
+        Range left, right;
+        if (!splitRange(input, range, left, right))
+            return;
+        const uint32_t child = static_cast<uint32_t>(tree.size());
+        tree[node].left = child;
+        tree[node].count = 0;
+        tree.resize(tree.size() + 2);
+        buildSubtree(input, tree, child, left);
+        buildSubtree(input, tree, child + 1, right);
+    }
+
+    // Fills nodes[target] with up to four descendants of binary node `source`, opening the
+    // inner child with the largest surface area until four slots are used; depth is raised to
+    // the deepest level of the 4-wide tree, the root being 0
+    void collapse(const std::vector<BuildNode>& binary, uint32_t source, uint32_t target, uint32_t level,
+                  uint32_t& depth) {
+        depth = std::max(depth, level);
+        uint32_t slots[4];
+        int used = 0;
+        if (binary[source].count > 0) {
+            slots[used++] = source;
+        } else {
+            slots[used++] = binary[source].left;
+            slots[used++] = binary[source].left + 1;
+        }
+        while (used < 4) {
+            int widest = -1;
+            float widestArea = -1.0f;
+            for (int slot = 0; slot < used; slot++) {
+                const BuildNode& node = binary[slots[slot]];
+                if (node.count == 0 && surfaceArea(node.box) > widestArea) {
+                    widest = slot;
+                    widestArea = surfaceArea(node.box);
+                }
+            }
+            if (widest < 0)
+                break;
+            const uint32_t left = binary[slots[widest]].left;
+            slots[widest] = left;
+            slots[used++] = left + 1;
+        }
+
+        // Boxes of unused slots are never read, refit() leaves them inverted
+        for (int slot = 0; slot < 4; slot++) {
+            nodes[target].child[slot] = EMPTY;
+            nodes[target].count[slot] = 0;
+            nodes[target].minX[slot] = nodes[target].minY[slot] = nodes[target].minZ[slot] = std::numeric_limits<float>::infinity();
+            nodes[target].maxX[slot] = nodes[target].maxY[slot] = nodes[target].maxZ[slot] = -std::numeric_limits<float>::infinity();
+        }
+        for (int slot = 0; slot < used; slot++) {
+            const BuildNode& node = binary[slots[slot]];
+            if (node.count > 0) {
+                nodes[target].child[slot] = node.first;
+                nodes[target].count[slot] = node.count;
+            } else {
+                const uint32_t child = static_cast<uint32_t>(nodes.size());
+                nodes[target].child[slot] = child;
+                nodes.emplace_back();
+                collapse(binary, slots[slot], child, level + 1, depth);
+            }
+        }
+    }
+
+    // Entry distances of the ray into the four child boxes; bit i of the result is set when
+    // child i is entered before maxDistance
+    static int intersectBoxes(const Node& node, const glm::vec3& origin, const glm::vec3& inverse, float maxDistance,
+                              float entry[4]) {
+#ifdef MESHBVH_SSE
+        const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+        const __m128 ix = _mm_set1_ps(inverse.x), iy = _mm_set1_ps(inverse.y), iz = _mm_set1_ps(inverse.z);
+        const __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix);
+        const __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+        const __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy);
+        const __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+        const __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz);
+        const __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+        const __m128 near = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                                       _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+        const __m128 far = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                                      _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(maxDistance)));
+        _mm_storeu_ps(entry, near);
+        return _mm_movemask_ps(_mm_cmple_ps(near, far));
+#else
+        int mask = 0;
+        for (int slot = 0; slot < 4; slot++) {
+            const float x0 = (node.minX[slot] - origin.x) * inverse.x, x1 = (node.maxX[slot] - origin.x) * inverse.x;
+            const float y0 = (node.minY[slot] - origin.y) * inverse.y, y1 = (node.maxY[slot] - origin.y) * inverse.y;
+            const float z0 = (node.minZ[slot] - origin.z) * inverse.z, z1 = (node.maxZ[slot] - origin.z) * inverse.z;
+            const float near = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+            const float far = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), maxDistance));
+            entry[slot] = near;
+            mask |= (near <= far) << slot;
+        }
+        return mask;
+#endif
+    }
+
+    // Moller-Trumbore; hits at or beyond hit.distance are ignored
+    bool intersectTriangle(const Ray& ray, uint32_t index, RayHit& hit) const {
+        const Triangle& triangle = triangles[index];
+        const glm::vec3 p = glm::cross(ray.direction, triangle.e2);
+        const float determinant = glm::dot(triangle.e1, p);
+        if (std::fabs(determinant) < 1e-12f)
+            return false;
+
+        const float inverse = 1.0f / determinant;
+        const glm::vec3 s = ray.origin - triangle.v0;
+        const float u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        const glm::vec3 q = glm::cross(s, triangle.e1);
+        const float v = glm::dot(ray.direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        const float distance = glm::dot(triangle.e2, q) * inverse;
+        if (distance < 0.0f || distance >= hit.distance)
+            return false;
+
+        hit.distance = distance;
+        hit.triangle = triangleOrder[index];
+        hit.u = u;
+        hit.v = v;
+        return true;
+    }
+
+    // Stack for one traversal, on the heap only for trees too deep for STACK_SIZE
+    uint32_t* nodeStack(uint32_t (&localStack)[STACK_SIZE], std::vector<uint32_t>& heapStack) const {
+        if (stackCapacity <= STACK_SIZE)
+            return localStack;
+        heapStack.resize(stackCapacity);
+        return heapStack.data();
+    }
+
+    template <bool AnyHit>
+    bool traverse(const Ray& ray, RayHit& hit) const {
+        if (nodes.empty())
+            return false;
+
+        // Huge instead of infinite reciprocals keep 0 * inverse from turning into NaN
+        glm::vec3 inverse;
+        for (int axis = 0; axis < 3; axis++)
+            inverse[axis] = ray.direction[axis] != 0.0f ? 1.0f / ray.direction[axis] : std::copysign(1e30f, ray.direction[axis]);
+
+        uint32_t localStack[STACK_SIZE];
+        std::vector<uint32_t> heapStack;
+        uint32_t* stack = nodeStack(localStack, heapStack);
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+        bool found = false;
+
+        while (stackSize > 0) {
+            const Node& node = nodes[stack[--stackSize]];
+            float entry[4];
+            const int mask = intersectBoxes(node, ray.origin, inverse, hit.distance, entry);
+
+            // Inner children are pushed farthest first so the nearest is visited next
+            uint32_t order[4];
+            int pushed = 0;
+            for (int slot = 0; slot < 4; slot++) {
+                if (!(mask & (1 << slot)) || node.child[slot] == EMPTY)
+                    continue;
+                if (node.count[slot] > 0) {
+                    for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++) {
+                        if (intersectTriangle(ray, i, hit)) {
+                            found = true;
+                            if (AnyHit)
+                                return true;
+                        }
+                    }
+                } else {
+                    int position = pushed++;
+                    while (position > 0 && entry[order[position - 1]] < entry[slot]) {
+                        order[position] = order[position - 1];
+                        position--;
+                    }
+                    order[position] = slot;
+                }
+            }
+            assert(stackSize + static_cast<uint32_t>(pushed) <= stackCapacity);
+            for (int i = 0; i < pushed; i++)
+                stack[stackSize++] = node.child[order[i]];
+        }
+        return found;
+    }
+
+    template <bool AnyOverlap>
+    bool overlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>* result) const {
+        if (nodes.empty())
+            return false;
+
+        const float radiusSquared = radius * radius;
+        uint32_t localStack[STACK_SIZE];
+        std::vector<uint32_t> heapStack;
+        uint32_t* stack = nodeStack(localStack, heapStack);
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+        bool found = false;
+
+        while (stackSize > 0) {
+            const Node& node = nodes[stack[--stackSize]];
+            for (int slot = 0; slot < 4; slot++) {
+                if (node.child[slot] == EMPTY)
+                    continue;
+                const glm::vec3 low(node.minX[slot], node.minY[slot], node.minZ[slot]);
+                const glm::vec3 high(node.maxX[slot], node.maxY[slot], node.maxZ[slot]);
+                const glm::vec3 offset = center - glm::min(glm::max(center, low), high);
+                if (glm::dot(offset, offset) > radiusSquared)
+                    continue;
+
+                if (node.count[slot] == 0) {
+                    assert(stackSize < stackCapacity);
+                    stack[stackSize++] = node.child[slot];
+                    continue;
+                }
+                for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++) {
+                    const Triangle& triangle = triangles[i];
+                    const glm::vec3 closest = closestPointOnTriangle(center, triangle.v0, triangle.v0 + triangle.e1,
+                                                                     triangle.v0 + triangle.e2);
+                    if (glm::dot(closest - center, closest - center) > radiusSquared)
+                        continue;
+                    found = true;
+                    if (AnyOverlap)
+                        return true;
+                    result->push_back(triangleOrder[i]);
+                }
+            }
+        }
+        return found;
+    }
+
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> triangleOrder;  // Tree order -> mesh triangle
+    std::vector<Triangle> triangles;      // In tree order
+    std::vector<Node> nodes;              // nodes[0] is the root
+    uint32_t stackCapacity = 0;           // Most nodes a traversal can have pending
+};
+
+#endif //MESHBVH_H
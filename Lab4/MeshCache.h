@@ -0,0 +1,385 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "MeshBvh.h"
+#include "VertexFormat.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Bump whenever a generator, the optimizer or the vertex format changes what a key produces
+constexpr uint32_t MESH_CACHE_VERSION = 4;
+
+// Cache file layout: this header, then the PackedVertex array, the indices, the MeshLevel
+// table and the Meshlet table. Each section starts on a MESH_CACHE_ALIGNMENT boundary, so a
+// mapped file is used in place.
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t indexType;  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    uint64_t key;
+    uint64_t vertexOffset, vertexBytes;
+    uint64_t indexOffset, indexBytes;
+    uint64_t levelOffset;
+    uint64_t meshletOffset;
+    uint32_t levelCount;
+    uint32_t meshletCount;
+    uint32_t indexCount;
+    uint32_t vertexSize;  // sizeof(PackedVertex) when written
+    float positionMin[3];
+    float positionScale[3];
+};
+
+constexpr char MESH_CACHE_MAGIC[8] = {'L', 'A', 'B', '4', 'M', 'S', 'H', '\0'};
+constexpr uint64_t MESH_CACHE_ALIGNMENT = 64;
+static_assert(std::is_trivially_copyable_v<MeshCacheHeader>, "Header is written and mapped as raw bytes");
+
+// 64-bit FNV-1a hash of a generator name and its parameters
+class MeshCacheKey {
+public:
+    explicit MeshCacheKey(const std::string& generator) : generator(generator) {
+        addBytes(generator.data(), generator.size());
+        addBytes(&MESH_CACHE_VERSION, sizeof(MESH_CACHE_VERSION));
+    }
+
+    template <typename T>
+    MeshCacheKey& add(T parameter) {
+        static_assert(std::is_arithmetic_v<T>, "Only numeric generator parameters are hashed");
+        addBytes(&parameter, sizeof(parameter));
+        return *this;
+    }
+
+    uint64_t value() const {
+        return hash;
+    }
+
+    // <generator>-<hash>.mesh
+    std::string fileName() const {
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+        return generator + "-" + hex + ".mesh";
+    }
+
+private:
+    void addBytes(const void* data, size_t size) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    std::string generator;
+    uint64_t hash = 14695981039346656037ull;
+};
+
+// A packed mesh in cache file layout: a read-only memory mapping of the file, or the same
+// bytes in memory when the file could not be written
+class CachedMesh {
+public:
+    CachedMesh() = default;
+    CachedMesh(const CachedMesh&) = delete;
+    CachedMesh& operator=(const CachedMesh&) = delete;
+
+    CachedMesh(CachedMesh&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    CachedMesh& operator=(CachedMesh&& other) noexcept {
+        if (this != &other) {
+            release();
+            bytes = std::exchange(other.bytes, nullptr);
+            size = std::exchange(other.size, 0);
+            owned = std::move(other.owned);
+#ifdef _WIN32
+            file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+            mapping = std::exchange(other.mapping, nullptr);
+#endif
+            mapped = std::exchange(other.mapped, false);
+        }
+        return *this;
+    }
+
+    ~CachedMesh() {
+        release();
+    }
+
+    // Maps the file; false if it is missing, truncated, or was written for another key or version
+    bool map(const std::string& path, uint64_t key) {
+        release();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(MeshCacheHeader))) {
+            release();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view) {
+            release();
+            return false;
+        }
+        bytes = static_cast<const unsigned char*>(view);
+        size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        const int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            return false;
+        struct stat status;
+        if (fstat(descriptor, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(MeshCacheHeader))) {
+            close(descriptor);
+            return false;
+        }
+        void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        close(descriptor);
+        if (view == MAP_FAILED)
+            return false;
+        bytes = static_cast<const unsigned char*>(view);
+        size = static_cast<size_t>(status.st_size);
+#endif
+        mapped = true;
+
+        if (!valid(key)) {
+            release();
+            return false;
+        }
+        return true;
+    }
+
+    // Uses bytes already in cache file layout
+    void adopt(std::vector<unsigned char> data) {
+        release();
+        owned = std::move(data);
+        bytes = owned.data();
+        size = owned.size();
+    }
+
+    void release() {
+        if (mapped) {
+#ifdef _WIN32
+            if (bytes)
+                UnmapViewOfFile(bytes);
+#else
+            munmap(const_cast<unsigned char*>(bytes), size);
+#endif
+        }
+#ifdef _WIN32
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#endif
+        owned.clear();
+        bytes = nullptr;
+        size = 0;
+        mapped = false;
+    }
+
+    const MeshCacheHeader& header() const {
+        return *reinterpret_cast<const MeshCacheHeader*>(bytes);
+    }
+
+    const void* vertexData() const {
+        return bytes + header().vertexOffset;
+    }
+
+    GLsizeiptr vertexBytes() const {
+        return static_cast<GLsizeiptr>(header().vertexBytes);
+    }
+
+    const void* indexData() const {
+        return bytes + header().indexOffset;
+    }
+
+    GLsizeiptr indexBytes() const {
+        return static_cast<GLsizeiptr>(header().indexBytes);
+    }
+
+    GLenum indexType() const {
+        return header().indexType;
+    }
+
+    GLsizeiptr indexSize() const {
+        return header().indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    GLsizei indexCount() const {
+        return static_cast<GLsizei>(header().indexCount);
+    }
+
+    const MeshLevel* levels() const {
+        return reinterpret_cast<const MeshLevel*>(bytes + header().levelOffset);
+    }
+
+    int levelCount() const {
+        return static_cast<int>(header().levelCount);
+    }
+
+    const Meshlet* meshlets() const {
+        return reinterpret_cast<const Meshlet*>(bytes + header().meshletOffset);
+    }
+
+    int meshletCount() const {
+        return static_cast<int>(header().meshletCount);
+    }
+
+    glm::vec3 positionMin() const {
+        return glm::vec3(header().positionMin[0], header().positionMin[1], header().positionMin[2]);
+    }
+
+    glm::vec3 positionScale() const {
+        return glm::vec3(header().positionScale[0], header().positionScale[1], header().positionScale[2]);
+    }
+
+private:
+    bool valid(uint64_t key) const {
+        const MeshCacheHeader& h = header();
+        const uint64_t indexSize = h.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        const uint64_t levelBytes = h.levelCount * sizeof(MeshLevel);
+        const uint64_t meshletBytes = h.meshletCount * sizeof(Meshlet);
+        return std::memcmp(h.magic, MESH_CACHE_MAGIC, sizeof(h.magic)) == 0
+            && h.version == MESH_CACHE_VERSION && h.key == key && h.vertexSize == sizeof(PackedVertex)
+            && (h.indexType == GL_UNSIGNED_SHORT || h.indexType == GL_UNSIGNED_INT)
+            && h.indexBytes == h.indexCount * indexSize
+            && h.vertexOffset + h.vertexBytes <= size && h.indexOffset + h.indexBytes <= size
+            && h.levelOffset + levelBytes <= size && h.meshletOffset + meshletBytes <= size;
+    }
+
+    const unsigned char* bytes = nullptr;
+    size_t size = 0;
+    std::vector<unsigned char> owned;
+    bool mapped = false;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+// Directory of cached meshes. load() maps the file for a key, or runs the generator, writes
+// its result and keeps the bytes in memory. A file that does not match its key, version or
+// vertex format is regenerated.
+class MeshCache {
+public:
+    explicit MeshCache(std::string directory) : directory(std::move(directory)) {}
+
+    template <typename Generate>
+    CachedMesh load(const MeshCacheKey& key, Generate&& generate) const {
+        const std::filesystem::path path = std::filesystem::path(directory) / key.fileName();
+
+        CachedMesh mesh;
+        if (mesh.map(path.string(), key.value()))
+            return mesh;
+
+        std::vector<unsigned char> data = serialize(generate(), key.value());
+        write(path, data);
+        mesh.adopt(std::move(data));
+        return mesh;
+    }
+
+    static std::vector<unsigned char> serialize(const PackedMesh& packed, uint64_t key) {
+        auto align = [](uint64_t offset) {
+            return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+        };
+
+        MeshCacheHeader header = {};
+        std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+        header.version = MESH_CACHE_VERSION;
+        header.indexType = packed.indexType();
+        header.key = key;
+        header.vertexOffset = align(sizeof(MeshCacheHeader));
+        header.vertexBytes = packed.vertices.size() * sizeof(PackedVertex);
+        header.indexOffset = align(header.vertexOffset + header.vertexBytes);
+        header.indexBytes = static_cast<uint64_t>(packed.indexBytes());
+        header.levelOffset = align(header.indexOffset + header.indexBytes);
+        header.levelCount = static_cast<uint32_t>(packed.levels.size());
+        header.meshletOffset = align(header.levelOffset + header.levelCount * sizeof(MeshLevel));
+        header.meshletCount = static_cast<uint32_t>(packed.meshlets.size());
+        header.indexCount = static_cast<uint32_t>(packed.indexCount());
+        header.vertexSize = sizeof(PackedVertex);
+        for (int axis = 0; axis < 3; axis++) {
+            header.positionMin[axis] = packed.positionMin[axis];
+            header.positionScale[axis] = packed.positionScale[axis];
+        }
+
+        const uint64_t levelBytes = header.levelCount * sizeof(MeshLevel);
+        const uint64_t meshletBytes = header.meshletCount * sizeof(Meshlet);
+        std::vector<unsigned char> data(header.meshletOffset + meshletBytes, 0);
+        std::memcpy(data.data(), &header, sizeof(header));
+        if (header.vertexBytes > 0)
+            std::memcpy(data.data() + header.vertexOffset, packed.vertices.data(), header.vertexBytes);
+        if (header.indexBytes > 0)
+            std::memcpy(data.data() + header.indexOffset, packed.indexData(), header.indexBytes);
+        if (levelBytes > 0)
+            std::memcpy(data.data() + header.levelOffset, packed.levels.data(), levelBytes);
+        if (meshletBytes > 0)
+            std::memcpy(data.data() + header.meshletOffset, packed.meshlets.data(), meshletBytes);
+        return data;
+    }
+
+private:
+    // Written to a temporary file and renamed, so a concurrent reader never maps half a file
+    static void write(const std::filesystem::path& path, const std::vector<unsigned char>& data) {
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+
+        std::filesystem::path temporary = path;
+        temporary += ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+            if (!file) {
+                std::cerr << "ERROR: Could not write mesh cache file " << temporary.string() << std::endl;
+                return;
+            }
+        }
+        std::filesystem::rename(temporary, path, error);
+        if (error)
+            std::cerr << "ERROR: Could not write mesh cache file " << path.string() << std::endl;
+    }
+
+    std::string directory;
+};
+
+inline void uploadPackedMesh(GLuint vao, GLuint vbo, GLuint ebo, const CachedMesh& mesh, GLenum usage) {
+    uploadPackedBuffers(vao, vbo, ebo, mesh.vertexData(), mesh.vertexBytes(), mesh.indexData(), mesh.indexBytes(), usage);
+}
+
+inline void setPackedMeshUniforms(ShaderProgram& program, const CachedMesh& mesh) {
+    setPositionDecodeUniforms(program, mesh.positionMin(), mesh.positionScale());
+}
+
+// BVH over the triangles of indices[firstIndex, firstIndex + indexCount), in model space
+inline void buildMeshBvh(MeshBvh& bvh, const CachedMesh& mesh, size_t firstIndex, size_t indexCount) {
+    bvh.build(decodePackedPositions(static_cast<const PackedVertex*>(mesh.vertexData()),
+                                    mesh.vertexBytes() / sizeof(PackedVertex), mesh.positionMin(), mesh.positionScale()),
+              widenIndices(mesh.indexData(), mesh.indexType(), firstIndex, indexCount));
+}
+
+#endif //MESHCACHE_H
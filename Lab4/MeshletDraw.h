@@ -0,0 +1,45 @@
+#ifndef MESHLETDRAW_H
+#define MESHLETDRAW_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include "Meshlets.h"
+
+// Index ranges for glMultiDrawElements; neighbouring visible meshlets are merged into one range
+struct MeshletDrawList {
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    size_t triangles = 0;
+};
+
+inline void cullMeshlets(const Meshlet* meshlets, int meshletCount, const MeshletView& view, GLsizeiptr indexSize,
+                         MeshletDrawList& list) {
+    list.counts.clear();
+    list.offsets.clear();
+    list.triangles = 0;
+
+    uint32_t runEnd = UINT32_MAX;
+    for (int i = 0; i < meshletCount; i++) {
+        const Meshlet& meshlet = meshlets[i];
+        if (!meshletVisible(meshlet, view))
+            continue;
+
+        if (meshlet.firstIndex == runEnd) {
+            list.counts.back() += static_cast<GLsizei>(meshlet.indexCount);
+        } else {
+            list.counts.push_back(static_cast<GLsizei>(meshlet.indexCount));
+            list.offsets.push_back((const void*)(static_cast<uintptr_t>(meshlet.firstIndex) * indexSize));
+        }
+        runEnd = meshlet.firstIndex + meshlet.indexCount;
+        list.triangles += meshlet.indexCount / 3;
+    }
+}
+
+inline void drawMeshlets(const MeshletDrawList& list, GLenum indexType) {
+    if (!list.counts.empty())
+        glMultiDrawElements(GL_TRIANGLES, list.counts.data(), indexType, list.offsets.data(),
+                            static_cast<GLsizei>(list.counts.size()));
+}
+
+#endif //MESHLETDRAW_H
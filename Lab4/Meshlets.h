@@ -0,0 +1,272 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include "MeshOptimizer.h"
+
+constexpr unsigned int MESHLET_MAX_VERTICES = 64;
+constexpr unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+// Contiguous run of triangles in a mesh's index buffer with bounds for culling: a sphere
+// around its vertices and a cone holding all of its triangle normals. coneCutoff is the sine
+// of the angle between coneAxis and the widest normal, 1 when the normals are too spread out
+// for the cluster to ever face entirely away.
+struct Meshlet {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+inline void computeMeshletBounds(Meshlet& meshlet, const std::vector<unsigned int>& indices,
+                                 const std::vector<float>& vertices, int stride) {
+    auto position = [&](unsigned int vertex) {
+        const float* p = &vertices[static_cast<size_t>(vertex) * stride];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    glm::vec3 low(1e30f), high(-1e30f), normalSum(0.0f);
+    std::vector<glm::vec3> normals;
+    for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+        const glm::vec3 a = position(indices[i]), b = position(indices[i + 1]), c = position(indices[i + 2]);
+        low = glm::min(low, glm::min(a, glm::min(b, c)));
+        high = glm::max(high, glm::max(a, glm::max(b, c)));
+
+        const glm::vec3 n = glm::cross(b - a, c - a);
+        const float length = glm::length(n);
+        if (length > 0.0f) {
+            normals.push_back(n / length);
+            normalSum += normals.back();
+        }
+    }
+
+    meshlet.center = 0.5f * (low + high);
+    meshlet.radius = 0.0f;
+    for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+        meshlet.radius = std::max(meshlet.radius, glm::length(position(indices[i]) - meshlet.center));
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    const float sumLength = glm::length(normalSum);
+    if (sumLength <= 0.0f)
+        return;
+
+    meshlet.coneAxis = normalSum / sumLength;
+    float minDot = 1.0f;
+    for (const glm::vec3& n : normals)
+        minDot = std::min(minDot, glm::dot(n, meshlet.coneAxis));
+
+    // Close to a half-space the test would almost never pass anyway
+    if (minDot > 0.1f)
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+// Partitions indices[firstIndex, firstIndex + indexCount) into meshlets of at most
+// MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles, and reorders the
+// triangles of the range so each meshlet is contiguous. A meshlet is seeded with the first
+// triangle left in the current order and grows over shared vertices, always taking the
+// neighbouring triangle that adds the fewest new vertices (the closest one on ties), which
+// keeps meshlets compact for tight bounds. The triangles of each meshlet are then put back
+// into vertex cache order with optimizeVertexCache(). No GL calls, so meshes can be split
+// on worker threads; MeshletDraw.h culls and draws the result. Positions are read from the first three floats of each vertex, `stride` floats apart.
+inline std::vector<Meshlet> buildMeshlets(std::vector<unsigned int>& indices, const std::vector<float>& vertices,
+                                          int stride, size_t firstIndex = 0, size_t indexCount = SIZE_MAX) {
+    indexCount = std::min(indexCount, indices.size() - firstIndex);
+    const size_t triangleCount = indexCount / 3;
+    const size_t vertexCount = vertices.size() / stride;
+    const unsigned int* triangles = indices.data() + firstIndex;
+
+    // Triangles around each vertex
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacencyOffsets[triangles[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+            adjacency[fill[triangles[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    auto centroid = [&](size_t triangle) {
+        glm::vec3 sum(0.0f);
+        for (int corner = 0; corner < 3; corner++) {
+            const float* p = &vertices[static_cast<size_t>(triangles[triangle * 3 + corner]) * stride];
+            sum += glm::vec3(p[0], p[1], p[2]);
+        }
+        return sum / 3.0f;
+    };
+
+    // Stamped with the id of the meshlet that holds the vertex / lists the triangle as a candidate
+    std::vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX);
+    std::vector<uint32_t> candidateMeshlet(triangleCount, UINT32_MAX);
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<unsigned int> ordered;
+    ordered.reserve(triangleCount * 3);
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> candidates;
+    size_t seed = 0;
+
+    while (true) {
+        while (seed < triangleCount && emitted[seed])
+            seed++;
+        if (seed == triangleCount)
+            break;
+
+        const uint32_t id = static_cast<uint32_t>(meshlets.size());
+        Meshlet meshlet = {};
+        meshlet.firstIndex = static_cast<uint32_t>(firstIndex + ordered.size());
+        unsigned int meshletVertices = 0, meshletTriangles = 0;
+        glm::vec3 centroidSum(0.0f);
+        candidates.clear();
+
+        auto newVertices = [&](size_t triangle) {
+            unsigned int count = 0;
+            for (int corner = 0; corner < 3; corner++)
+                count += vertexMeshlet[triangles[triangle * 3 + corner]] != id;
+            return count;
+        };
+
+        auto add = [&](size_t triangle) {
+            emitted[triangle] = true;
+            meshletTriangles++;
+            centroidSum += centroid(triangle);
+            for (int corner = 0; corner < 3; corner++) {
+                const unsigned int vertex = triangles[triangle * 3 + corner];
+                ordered.push_back(vertex);
+                if (vertexMeshlet[vertex] == id)
+                    continue;
+                vertexMeshlet[vertex] = id;
+                meshletVertices++;
+                for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+                    const uint32_t neighbour = adjacency[a];
+                    if (!emitted[neighbour] && candidateMeshlet[neighbour] != id) {
+                        candidateMeshlet[neighbour] = id;
+                        candidates.push_back(neighbour);
+                    }
+                }
+            }
+        };
+
+        add(seed);
+        while (meshletTriangles < MESHLET_MAX_TRIANGLES) {
+            const glm::vec3 center = centroidSum / static_cast<float>(meshletTriangles);
+            size_t best = SIZE_MAX;
+            unsigned int bestNew = 4;
+            float bestDistance = 0.0f;
+
+            // Drop candidates taken meanwhile while scanning
+            size_t kept = 0;
+            for (uint32_t triangle : candidates) {
+                if (emitted[triangle])
+                    continue;
+                candidates[kept++] = triangle;
+
+                const unsigned int count = newVertices(triangle);
+                if (meshletVertices + count > MESHLET_MAX_VERTICES || count > bestNew)
+                    continue;
+                const glm::vec3 offset = centroid(triangle) - center;
+                const float distance = glm::dot(offset, offset);
+                if (count < bestNew || distance < bestDistance) {
+                    best = triangle;
+                    bestNew = count;
+                    bestDistance = distance;
+                }
+            }
+            candidates.resize(kept);
+
+            if (best == SIZE_MAX)
+                break;
+            add(best);
+        }
+
+        meshlet.indexCount = meshletTriangles * 3;
+        meshlets.push_back(meshlet);
+    }
+
+    // Growing by distance breaks up the fans of a cache-ordered input, so each meshlet's
+    // triangles are cache-ordered again on their own, over meshlet-local vertex numbers
+    std::vector<uint32_t> localVertex(vertexCount, UINT32_MAX);
+    std::vector<unsigned int> localIndices, meshletVertices;
+    for (const Meshlet& meshlet : meshlets) {
+        unsigned int* meshletIndices = ordered.data() + (meshlet.firstIndex - firstIndex);
+        localIndices.clear();
+        meshletVertices.clear();
+        for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+            const unsigned int vertex = meshletIndices[i];
+            if (localVertex[vertex] == UINT32_MAX) {
+                localVertex[vertex] = static_cast<uint32_t>(meshletVertices.size());
+                meshletVertices.push_back(vertex);
+            }
+            localIndices.push_back(localVertex[vertex]);
+        }
+        optimizeVertexCache(localIndices, meshletVertices.size());
+        for (uint32_t i = 0; i < meshlet.indexCount; i++)
+            meshletIndices[i] = meshletVertices[localIndices[i]];
+        for (unsigned int vertex : meshletVertices)
+            localVertex[vertex] = UINT32_MAX;
+    }
+
+    std::copy(ordered.begin(), ordered.end(), indices.begin() + firstIndex);
+    for (Meshlet& meshlet : meshlets)
+        computeMeshletBounds(meshlet, indices, vertices, stride);
+    return meshlets;
+}
+
+// Culling inputs in the model space of one object
+struct MeshletView {
+    glm::vec4 planes[6];  // Frustum planes, inside where dot(plane, (p, 1)) >= 0
+    glm::vec3 eye;        // Perspective: camera position
+    glm::vec3 direction;  // Orthographic: viewing direction
+    bool perspective;
+    bool cullBackfacing;  // Only for closed or one-sided meshes
+};
+
+// Planes are read off the rows of projection * view * model (Gribb and Hartmann), so they
+// come out in model space
+inline MeshletView makeMeshletView(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+                                   bool perspective, bool cullBackfacing) {
+    MeshletView result;
+    const glm::mat4 clip = projection * view * model;
+    const glm::vec4 rowX(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+    const glm::vec4 rowY(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+    const glm::vec4 rowZ(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+    const glm::vec4 rowW(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+    const glm::vec4 planes[6] = {rowW + rowX, rowW - rowX, rowW + rowY, rowW - rowY, rowW + rowZ, rowW - rowZ};
+    for (int i = 0; i < 6; i++)
+        result.planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+
+    const glm::mat4 cameraToModel = glm::inverse(view * model);
+    result.eye = glm::vec3(cameraToModel * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    result.direction = glm::normalize(glm::vec3(cameraToModel * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f)));
+    result.perspective = perspective;
+    result.cullBackfacing = cullBackfacing;
+    return result;
+}
+
+inline bool meshletVisible(const Meshlet& meshlet, const MeshletView& view) {
+    for (const glm::vec4& plane : view.planes) {
+        if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius)
+            return false;
+    }
+
+    if (!view.cullBackfacing)
+        return true;
+
+    // Every normal of the cone points away from every ray into the bounding sphere
+    if (view.perspective) {
+        const glm::vec3 offset = meshlet.center - view.eye;
+        return glm::dot(offset, meshlet.coneAxis) < meshlet.coneCutoff * glm::length(offset) + meshlet.radius;
+    }
+    return glm::dot(view.direction, meshlet.coneAxis) < meshlet.coneCutoff;
+}
+
+#endif //MESHLETS_H
@@ -0,0 +1,391 @@
+#ifndef MULTIPATCHSURFACE_H
+#define MULTIPATCHSURFACE_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <vector>
+#include "BezierSurface.h"
+#include "BezierTessellator.h"
+#include "ThreadPool.h"
+#include "VertexFormat.h"
+
+// Blossom (polar form) of the cubic Bezier curve with control points p at (t1, t2, t3):
+// de Casteljau with a different parameter on every level. f(a, a, a), f(a, a, b),
+// f(a, b, b), f(b, b, b) are the control points of the curve's piece over [a, b].
+inline glm::vec3 cubicBlossom(const glm::vec3 (&p)[4], float t1, float t2, float t3) {
+    const float t[3] = {t1, t2, t3};
+    glm::vec3 level[4] = {p[0], p[1], p[2], p[3]};
+    for (int step = 0; step < 3; step++) {
+        for (int k = 0; k < 3 - step; k++)
+            level[k] = glm::mix(level[k], level[k + 1], t[step]);
+    }
+    return level[0];
+}
+
+// Editable surface of patchesPerSide x patchesPerSide bicubic Bezier patches over [0, 1]^2,
+// with one shared net of (3 * patchesPerSide + 1)^2 control points and a diamond trim in
+// global parameters.
+//
+// Neighbouring patches share their boundary row of control points, and every junction
+// point (net index a multiple of 3 strictly inside the net) is kept at the midpoint of its
+// two neighbours across the junction, which makes the surface C1 across patch borders.
+// Moving a junction point drags its neighbours along like a spline knot; moving any other
+// point re-derives the junctions next to it.
+//
+// Every patch is tessellated on its own into a fixed vertex range of one packed mesh. The
+// vertex count of a patch depends only on its parameters and the trim, never on the
+// control points, so the ranges and the index buffer are built once. An edit marks only
+// the patches whose control points it changed; update() re-tessellates them on a private
+// worker thread, and uploadFinishedPatches() writes just their ranges with glBufferSubData,
+// so an edit costs in proportion to its size rather than the surface's.
+class MultiPatchSurface {
+public:
+    // Splits `patch` into patchesPerSide^2 pieces of exactly the same shape and tessellates
+    // each of them on a samplesPerPatch^2 grid
+    MultiPatchSurface(const BezierSurface& patch, const DiamondTrim& trim, int patchesPerSide = 4,
+                      int samplesPerPatch = 17)
+        : trim(trim), patchesPerSide(std::max(patchesPerSide, 1)), samplesPerPatch(std::max(samplesPerPatch, 2)) {
+        const int side = controlsPerSide();
+        net.resize(static_cast<size_t>(side) * side);
+
+        // Blossom arguments of net index `index` along one direction
+        auto pieceParams = [&](int index, float (&t)[3]) {
+            const int piece = std::min(index / 3, this->patchesPerSide - 1);
+            const int k = index - piece * 3;
+            const float a = static_cast<float>(piece) / this->patchesPerSide;
+            const float b = static_cast<float>(piece + 1) / this->patchesPerSide;
+            for (int m = 0; m < 3; m++)
+                t[m] = m < 3 - k ? a : b;
+        };
+        for (int i = 0; i < side; i++) {
+            for (int j = 0; j < side; j++) {
+                float tu[3], tv[3];
+                pieceParams(i, tu);
+                pieceParams(j, tv);
+                glm::vec3 column[4];
+                for (int a = 0; a < 4; a++) {
+                    const glm::vec3 row[4] = {patch.controlPoint(a, 0), patch.controlPoint(a, 1),
+                                              patch.controlPoint(a, 2), patch.controlPoint(a, 3)};
+                    column[a] = cubicBlossom(row, tv[0], tv[1], tv[2]);
+                }
+                control(i, j) = cubicBlossom(column, tu[0], tu[1], tu[2]);
+            }
+        }
+
+        const int count = patchCount();
+        ranges.resize(count);
+        patchVertices.resize(count);
+        dirty.assign(count, false);
+
+        std::vector<unsigned int> indices;
+        uint32_t firstVertex = 0;
+        for (int p = 0; p < count; p++) {
+            std::vector<unsigned int> patchIndices;
+            patchVertices[p] = tessellatePatch(snapshot(p), patchIndices);
+            ranges[p] = {firstVertex, static_cast<uint32_t>(patchVertices[p].size() / 6)};
+            for (unsigned int index : patchIndices)
+                indices.push_back(firstVertex + index);
+            firstVertex += ranges[p].vertexCount;
+        }
+
+        mesh.vertices.resize(firstVertex);
+        if (firstVertex <= 65536)
+            mesh.shortIndices.assign(indices.begin(), indices.end());
+        else
+            mesh.intIndices.assign(indices.begin(), indices.end());
+        fitQuantization();
+        for (int p = 0; p < count; p++)
+            packPatch(p);
+    }
+
+    int controlsPerSide() const {
+        return patchesPerSide * 3 + 1;
+    }
+
+    int patchCount() const {
+        return patchesPerSide * patchesPerSide;
+    }
+
+    glm::vec3 controlPoint(int i, int j) const {
+        return net[static_cast<size_t>(i) * controlsPerSide() + j];
+    }
+
+    // Packed vertices and indices of all patches, as last uploaded
+    const PackedMesh& packedMesh() const {
+        return mesh;
+    }
+
+    // Control point closest in angle to the ray from origin along direction, in front of it
+    bool nearestControlPoint(const glm::vec3& origin, const glm::vec3& direction, int& i, int& j) const {
+        const glm::vec3 unit = glm::normalize(direction);
+        float best = std::numeric_limits<float>::infinity();
+        for (int a = 0; a < controlsPerSide(); a++) {
+            for (int b = 0; b < controlsPerSide(); b++) {
+                const glm::vec3 offset = controlPoint(a, b) - origin;
+                const float along = glm::dot(offset, unit);
+                if (along <= 0.0f)
+                    continue;
+
+                // Squared tangent of the angle between the ray and the point
+                const float angle = (glm::dot(offset, offset) - along * along) / (along * along);
+                if (angle < best) {
+                    best = angle;
+                    i = a;
+                    j = b;
+                }
+            }
+        }
+        return best < std::numeric_limits<float>::infinity();
+    }
+
+    void moveControlPoint(int i, int j, const glm::vec3& offset) {
+        auto junction = [&](int k) {
+            return k % 3 == 0 && k > 0 && k < controlsPerSide() - 1;
+        };
+        const int rowBegin = junction(i) ? i - 1 : i, rowEnd = junction(i) ? i + 1 : i;
+        const int columnBegin = junction(j) ? j - 1 : j, columnEnd = junction(j) ? j + 1 : j;
+        for (int r = rowBegin; r <= rowEnd; r++) {
+            for (int c = columnBegin; c <= columnEnd; c++)
+                control(r, c) += offset;
+        }
+
+        // The junctions next to the moved points change with them
+        restoreContinuity(rowBegin - 1, rowEnd + 1, columnBegin - 1, columnEnd + 1);
+        markDirty(rowBegin - 1, rowEnd + 1, columnBegin - 1, columnEnd + 1);
+    }
+
+    // Starts re-tessellating the dirty patches unless a batch is still running; patches
+    // edited meanwhile stay dirty for the next batch
+    void update() {
+        if (busy.load())
+            return;
+
+        std::vector<PatchJob> jobs;
+        for (int p = 0; p < patchCount(); p++) {
+            if (dirty[p]) {
+                jobs.push_back(snapshot(p));
+                dirty[p] = false;
+            }
+        }
+        if (jobs.empty())
+            return;
+
+        busy = true;
+        worker.submit([this, jobs = std::move(jobs)] {
+            std::vector<PatchResult> results(jobs.size());
+            ThreadPool::shared().parallelFor(static_cast<int>(jobs.size()), [&](int begin, int end) {
+                for (int k = begin; k < end; k++) {
+                    std::vector<unsigned int> unusedIndices;
+                    results[k].patch = jobs[k].patch;
+                    results[k].vertices = tessellatePatch(jobs[k], unusedIndices);
+                }
+            }, 1);
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            readyPatches.insert(readyPatches.end(), std::make_move_iterator(results.begin()),
+                                std::make_move_iterator(results.end()));
+            busy = false;
+        });
+    }
+
+    // Main thread: packs the patches finished since the last call and writes their vertex
+    // ranges into vbo, which must hold packedMesh(). Patches that moved out of the
+    // quantization box re-quantize the whole mesh, which then goes up in one piece (and
+    // changes the position decode constants). True when the mesh changed.
+    bool uploadFinishedPatches(GLuint vbo) {
+        std::vector<PatchResult> results;
+        {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            results.swap(readyPatches);
+        }
+        if (results.empty())
+            return false;
+
+        const glm::vec3 low = mesh.positionMin, high = mesh.positionMin + mesh.positionScale;
+        std::vector<bool> changed(patchCount(), false);
+        bool outside = false;
+        for (PatchResult& result : results) {
+            if (result.vertices.size() != patchVertices[result.patch].size()) {
+                std::cerr << "ERROR: Patch " << result.patch << " changed its vertex count" << std::endl;
+                continue;
+            }
+            patchVertices[result.patch] = std::move(result.vertices);
+            changed[result.patch] = true;
+
+            const std::vector<float>& vertices = patchVertices[result.patch];
+            for (size_t v = 0; v < vertices.size() && !outside; v += 6) {
+                const glm::vec3 p(vertices[v], vertices[v + 1], vertices[v + 2]);
+                outside = p.x < low.x || p.y < low.y || p.z < low.z || p.x > high.x || p.y > high.y || p.z > high.z;
+            }
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (outside) {
+            fitQuantization();
+            for (int p = 0; p < patchCount(); p++)
+                packPatch(p);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, mesh.vertices.size() * sizeof(PackedVertex), mesh.vertices.data());
+        } else {
+            // Ranges follow patch order, so a run of changed patches goes up in one call
+            for (int p = 0; p < patchCount();) {
+                if (!changed[p]) {
+                    p++;
+                    continue;
+                }
+                const int first = p;
+                for (; p < patchCount() && changed[p]; p++)
+                    packPatch(p);
+                const PatchRange& last = ranges[p - 1];
+                const uint32_t begin = ranges[first].firstVertex, end = last.firstVertex + last.vertexCount;
+                glBufferSubData(GL_ARRAY_BUFFER, begin * sizeof(PackedVertex), (end - begin) * sizeof(PackedVertex),
+                                mesh.vertices.data() + begin);
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return true;
+    }
+
+private:
+    struct PatchRange {
+        uint32_t firstVertex;
+        uint32_t vertexCount;
+    };
+
+    // Copy of one patch's control points for the worker, which never reads the live net
+    struct PatchJob {
+        int patch;
+        glm::vec3 points[4][4];
+    };
+
+    struct PatchResult {
+        int patch = 0;
+        std::vector<float> vertices;  // Position + normal, 6 floats per vertex
+    };
+
+    glm::vec3& control(int i, int j) {
+        return net[static_cast<size_t>(i) * controlsPerSide() + j];
+    }
+
+    PatchJob snapshot(int patch) const {
+        PatchJob job;
+        job.patch = patch;
+        const int pu = patch / patchesPerSide, pv = patch % patchesPerSide;
+        for (int a = 0; a < 4; a++) {
+            for (int b = 0; b < 4; b++)
+                job.points[a][b] = controlPoint(pu * 3 + a, pv * 3 + b);
+        }
+        return job;
+    }
+
+    // Position + normal vertices of one patch and indices into them. The trim is moved
+    // into the patch's own [0, 1]^2 parameters, which scale the global ones by patchesPerSide.
+    std::vector<float> tessellatePatch(const PatchJob& job, std::vector<unsigned int>& indices) const {
+        const int pu = job.patch / patchesPerSide, pv = job.patch % patchesPerSide;
+        DiamondTrim localTrim;
+        localTrim.centerU = trim.centerU * patchesPerSide - pu;
+        localTrim.centerV = trim.centerV * patchesPerSide - pv;
+        localTrim.radius = trim.radius * patchesPerSide;
+
+        const BezierSurface surface(job.points);
+        const std::vector<float> uParams = trimAwareSamples(0.0f, 1.0f, samplesPerPatch, localTrim.centerU);
+        const std::vector<float> vParams = trimAwareSamples(0.0f, 1.0f, samplesPerPatch, localTrim.centerV);
+
+        std::vector<float> vertices;
+        tessellateTrimmedGrid(surface, localTrim, uParams, vParams, vertices, indices);
+        return vertices;
+    }
+
+    // Re-derives the junction points in net rows [rowBegin, rowEnd] x columns [columnBegin,
+    // columnEnd]: junction columns from their neighbours first, then junction rows, whose
+    // points on junction columns thereby become the average of four neighbours
+    void restoreContinuity(int rowBegin, int rowEnd, int columnBegin, int columnEnd) {
+        const int last = controlsPerSide() - 1;
+        auto junction = [&](int k) {
+            return k % 3 == 0 && k > 0 && k < last;
+        };
+        rowBegin = std::max(rowBegin, 0);
+        rowEnd = std::min(rowEnd, last);
+        columnBegin = std::max(columnBegin, 0);
+        columnEnd = std::min(columnEnd, last);
+
+        for (int r = std::max(rowBegin - 1, 0); r <= std::min(rowEnd + 1, last); r++) {
+            for (int c = columnBegin; c <= columnEnd; c++) {
+                if (!junction(r) && junction(c))
+                    control(r, c) = 0.5f * (control(r, c - 1) + control(r, c + 1));
+            }
+        }
+        for (int r = rowBegin; r <= rowEnd; r++) {
+            if (!junction(r))
+                continue;
+            for (int c = columnBegin; c <= columnEnd; c++)
+                control(r, c) = 0.5f * (control(r - 1, c) + control(r + 1, c));
+        }
+    }
+
+    // Patch (pu, pv) uses net rows 3pu .. 3pu + 3 and columns 3pv .. 3pv + 3
+    void markDirty(int rowBegin, int rowEnd, int columnBegin, int columnEnd) {
+        for (int pu = 0; pu < patchesPerSide; pu++) {
+            if (pu * 3 > rowEnd || pu * 3 + 3 < rowBegin)
+                continue;
+            for (int pv = 0; pv < patchesPerSide; pv++) {
+                if (pv * 3 <= columnEnd && pv * 3 + 3 >= columnBegin)
+                    dirty[pu * patchesPerSide + pv] = true;
+            }
+        }
+    }
+
+    // Quantization box: the bounds of the surface with a quarter of its size to spare on
+    // every side, so that most edits stay inside and upload only their own patches
+    void fitQuantization() {
+        glm::vec3 low(std::numeric_limits<float>::infinity()), high(-std::numeric_limits<float>::infinity());
+        for (const std::vector<float>& vertices : patchVertices) {
+            for (size_t v = 0; v < vertices.size(); v += 6) {
+                const glm::vec3 p(vertices[v], vertices[v + 1], vertices[v + 2]);
+                low = glm::min(low, p);
+                high = glm::max(high, p);
+            }
+        }
+        if (low.x > high.x)
+            low = high = glm::vec3(0.0f);
+
+        const glm::vec3 size = high - low;
+        const float margin = std::max(0.25f * std::max(size.x, std::max(size.y, size.z)), 1e-3f);
+        mesh.positionMin = low - glm::vec3(margin);
+        mesh.positionScale = size + glm::vec3(2.0f * margin);
+        inverseScale = inversePositionScale(mesh.positionScale);
+    }
+
+    void packPatch(int patch) {
+        const std::vector<float>& vertices = patchVertices[patch];
+        PackedVertex* out = mesh.vertices.data() + ranges[patch].firstVertex;
+        for (size_t v = 0; v < vertices.size() / 6; v++)
+            out[v] = packVertex(&vertices[v * 6], mesh.positionMin, inverseScale);
+    }
+
+    DiamondTrim trim;
+    int patchesPerSide;
+    int samplesPerPatch;
+    std::vector<glm::vec3> net;  // Row-major along u, like TensorSurface
+
+    std::vector<PatchRange> ranges;
+    std::vector<std::vector<float>> patchVertices;  // Unpacked, for re-quantizing
+    std::vector<bool> dirty;
+    PackedMesh mesh;
+    glm::vec3 inverseScale = glm::vec3(1.0f);
+
+    std::atomic<bool> busy{false};
+    std::mutex resultMutex;
+    std::vector<PatchResult> readyPatches;
+
+    // Declared last: destroyed first, so a running batch finishes while the members above still exist
+    ThreadPool worker{1};
+};
+
+#endif //MULTIPATCHSURFACE_H
@@ -0,0 +1,382 @@
+#ifndef SHADERRELOAD_H
+#define SHADERRELOAD_H
+
+#include <GL/glew.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "ShaderCache.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// One stage of a program whose source is read from a file
+struct ShaderSource {
+    GLenum type;
+    std::string fileName;
+    std::string source;
+};
+
+// Reads every stage's file from directory; on failure the sources are left as they were
+inline bool readShaderSources(const std::string& directory, std::vector<ShaderSource>& sources) {
+    std::vector<std::string> texts;
+    for (const ShaderSource& stage : sources) {
+        const std::filesystem::path path = std::filesystem::path(directory) / stage.fileName;
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream text;
+        if (!file || !(text << file.rdbuf())) {
+            std::cerr << "ERROR: Could not read shader file " << path.string() << std::endl;
+            return false;
+        }
+        texts.push_back(text.str());
+    }
+    for (size_t s = 0; s < sources.size(); s++)
+        sources[s].source = std::move(texts[s]);
+    return true;
+}
+
+// Stage list for ProgramCache::load; points into sources, which must outlive it
+inline std::vector<ShaderStage> shaderStages(const std::vector<ShaderSource>& sources) {
+    std::vector<ShaderStage> stages;
+    for (const ShaderSource& stage : sources)
+        stages.push_back({stage.type, stage.source.c_str()});
+    return stages;
+}
+
+// Reports saves to a set of files in one directory. On Linux an inotify watch on the
+// directory also sees editors that save by renaming a temporary file over the original;
+// elsewhere the files' modification times are compared every POLL_INTERVAL.
+class ShaderFileWatcher {
+public:
+    static constexpr std::chrono::milliseconds POLL_INTERVAL{250};
+
+    bool init(const std::string& watchedDirectory, const std::vector<ShaderSource>& sources) {
+        directory = watchedDirectory;
+        fileNames.clear();
+        for (const ShaderSource& stage : sources)
+            fileNames.push_back(stage.fileName);
+
+#ifdef __linux__
+        descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (descriptor < 0 || inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cerr << "ERROR: Could not watch shader directory " << directory << std::endl;
+            destroy();
+            return false;
+        }
+#else
+        writeTimes.assign(fileNames.size(), {});
+        for (size_t i = 0; i < fileNames.size(); i++) {
+            std::error_code error;
+            writeTimes[i] = std::filesystem::last_write_time(std::filesystem::path(directory) / fileNames[i], error);
+        }
+        nextPoll = std::chrono::steady_clock::now() + POLL_INTERVAL;
+#endif
+        return true;
+    }
+
+    // True if a watched file was written since the last call
+    bool changed() {
+        bool anyChanged = false;
+#ifdef __linux__
+        if (descriptor < 0)
+            return false;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(descriptor, buffer, sizeof(buffer))) > 0) {
+            for (char* entry = buffer; entry < buffer + length;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(entry);
+                if (event->len > 0 && watched(event->name))
+                    anyChanged = true;
+                entry += sizeof(inotify_event) + event->len;
+            }
+        }
+#else
+        const auto now = std::chrono::steady_clock::now();
+        if (now < nextPoll)
+            return false;
+        nextPoll = now + POLL_INTERVAL;
+
+        for (size_t i = 0; i < fileNames.size(); i++) {
+            std::error_code error;
+            const auto writeTime = std::filesystem::last_write_time(std::filesystem::path(directory) / fileNames[i], error);
+            if (!error && writeTime != writeTimes[i]) {
+                writeTimes[i] = writeTime;
+                anyChanged = true;
+            }
+        }
+#endif
+        return anyChanged;
+    }
+
+    void destroy() {
+#ifdef __linux__
+        if (descriptor >= 0)
+            close(descriptor);
+        descriptor = -1;
+#endif
+    }
+
+private:
+    bool watched(const std::string& name) const {
+        for (const std::string& fileName : fileNames)
+            if (fileName == name)
+                return true;
+        return false;
+    }
+
+    std::string directory;
+    std::vector<std::string> fileNames;
+#ifdef __linux__
+    int descriptor = -1;
+#else
+    std::vector<std::filesystem::file_time_type> writeTimes;
+    std::chrono::steady_clock::time_point nextPoll;
+#endif
+};
+
+// Builds programs without stalling the render loop. Each build carries a caller-chosen key
+// that poll() hands back with the program, so several programs can be in flight. Given a
+// context shared with the window's, a worker thread compiles and links on it. Otherwise, with
+// KHR_parallel_shader_compile, the driver compiles on its own threads and poll() only asks
+// GL_COMPLETION_STATUS_KHR; drivers with the extension may still parse the source on the
+// calling thread, so the worker comes first. With neither, compile() builds the program on
+// the spot. Programs are not stored as binaries here: ProgramCache picks the edited sources
+// up on the next start.
+class BackgroundProgramCompiler {
+public:
+    static bool parallelCompileSupported() {
+        return GLEW_KHR_parallel_shader_compile;
+    }
+
+    // attachContext makes the shared context current on the worker thread and detachContext
+    // releases it; without them no worker is started
+    void init(std::function<void()> attachContext, std::function<void()> detachContext) {
+        if (attachContext) {
+            mode = Mode::Worker;
+            stopping = false;
+            worker = std::thread([this, attachContext, detachContext] {
+                attachContext();
+                workerLoop();
+                if (detachContext)
+                    detachContext();
+            });
+        } else if (parallelCompileSupported()) {
+            mode = Mode::Parallel;
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);  // Let the driver choose
+        } else {
+            mode = Mode::Immediate;
+        }
+    }
+
+    // False if compile() builds on the calling thread
+    bool background() const {
+        return mode != Mode::Immediate;
+    }
+
+    // Starts building a program from sources; a build for the same key that has not started
+    // yet is replaced
+    void compile(uint64_t key, std::vector<ShaderSource> sources) {
+        switch (mode) {
+            case Mode::Parallel:
+                for (auto it = inFlight.begin(); it != inFlight.end(); ++it) {
+                    if (it->key == key) {
+                        discard(*it);
+                        inFlight.erase(it);
+                        break;
+                    }
+                }
+                inFlight.push_back(startBuild(key, sources));
+                break;
+            case Mode::Worker: {
+                std::lock_guard<std::mutex> lock(mutex);
+                bool replaced = false;
+                for (auto& job : jobs) {
+                    if (job.first == key) {
+                        job.second = std::move(sources);
+                        replaced = true;
+                        break;
+                    }
+                }
+                if (!replaced)
+                    jobs.emplace_back(key, std::move(sources));
+                jobReady.notify_one();
+                break;
+            }
+            case Mode::Immediate: {
+                Build build = startBuild(key, sources);
+                addFinished(key, finishBuild(build));
+                break;
+            }
+        }
+    }
+
+    // Takes one program that linked since the last call; the caller owns it. Failed builds
+    // are reported and deleted, so the program in use stays in place.
+    bool poll(uint64_t& key, GLuint& program) {
+        if (mode == Mode::Parallel) {
+            for (size_t i = 0; i < inFlight.size();) {
+                GLint complete = GL_FALSE;
+                glGetProgramiv(inFlight[i].program, GL_COMPLETION_STATUS_KHR, &complete);
+                if (!complete) {
+                    i++;
+                    continue;
+                }
+                addFinished(inFlight[i].key, finishBuild(inFlight[i]));
+                inFlight.erase(inFlight.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished.empty())
+            return false;
+        key = finished.front().first;
+        program = finished.front().second;
+        finished.erase(finished.begin());
+        return true;
+    }
+
+    void destroy() {
+        if (worker.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            jobReady.notify_one();
+            worker.join();
+        }
+        for (Build& build : inFlight)
+            discard(build);
+        inFlight.clear();
+        for (const auto& done : finished)
+            glDeleteProgram(done.second);
+        finished.clear();
+        jobs.clear();
+    }
+
+private:
+    enum class Mode {
+        Parallel,
+        Worker,
+        Immediate,
+    };
+
+    struct Build {
+        uint64_t key = 0;
+        GLuint program = 0;
+        std::vector<GLuint> shaders;
+        std::vector<std::string> fileNames;  // Per shader, for error messages
+    };
+
+    // Issues the compiles and the link without asking for their results
+    static Build startBuild(uint64_t key, const std::vector<ShaderSource>& sources) {
+        Build build;
+        build.key = key;
+        build.program = glCreateProgram();
+        for (const ShaderSource& stage : sources) {
+            GLuint shader = glCreateShader(stage.type);
+            const char* text = stage.source.c_str();
+            glShaderSource(shader, 1, &text, nullptr);
+            glCompileShader(shader);
+            glAttachShader(build.program, shader);
+            build.shaders.push_back(shader);
+            build.fileNames.push_back(stage.fileName);
+        }
+        glLinkProgram(build.program);
+        return build;
+    }
+
+    // Waits for the build, reports its errors and frees the shaders; 0 if it failed
+    static GLuint finishBuild(Build& build) {
+        char infoLog[512];
+        for (size_t s = 0; s < build.shaders.size(); s++) {
+            const GLuint shader = build.shaders[s];
+            GLint success;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
+                std::cerr << "ERROR: Shader compilation failed (" << build.fileNames[s] << ")\n" << infoLog << std::endl;
+            }
+            glDetachShader(build.program, shader);
+            glDeleteShader(shader);
+        }
+        build.shaders.clear();
+
+        GLint success;
+        glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(build.program, sizeof(infoLog), nullptr, infoLog);
+            std::cerr << "ERROR: Shader program linking failed\n" << infoLog << std::endl;
+            glDeleteProgram(build.program);
+            return 0;
+        }
+        return build.program;
+    }
+
+    static void discard(Build& build) {
+        for (GLuint shader : build.shaders)
+            glDeleteShader(shader);
+        if (build.program != 0)
+            glDeleteProgram(build.program);
+        build = Build();
+    }
+
+    // A newer program for a key supersedes one the render loop has not picked up yet
+    void addFinished(uint64_t key, GLuint program) {
+        if (program == 0)
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& done : finished) {
+            if (done.first == key) {
+                glDeleteProgram(done.second);
+                done.second = program;
+                return;
+            }
+        }
+        finished.emplace_back(key, program);
+    }
+
+    void workerLoop() {
+        for (;;) {
+            std::pair<uint64_t, std::vector<ShaderSource>> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            Build build = startBuild(job.first, job.second);
+            const GLuint program = finishBuild(build);
+            // The program has to be complete before the render context may use it
+            glFinish();
+            addFinished(job.first, program);
+        }
+    }
+
+    Mode mode = Mode::Immediate;
+    std::vector<Build> inFlight;  // Parallel mode only
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::deque<std::pair<uint64_t, std::vector<ShaderSource>>> jobs;
+    bool stopping = false;
+    std::vector<std::pair<uint64_t, GLuint>> finished;
+};
+
+#endif //SHADERRELOAD_H
@@ -0,0 +1,152 @@
+#ifndef SHADERVARIANTS_H
+#define SHADERVARIANTS_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ShaderCache.h"
+#include "ShaderProgram.h"
+#include "ShaderReload.h"
+
+// Source with `defines` inserted after its #version line, which has to stay first. A #line
+// directive follows them so compiler messages still refer to the file's own line numbers.
+inline std::string insertDefines(const std::string& source, const std::string& defines) {
+    size_t insertAt = 0;
+    const size_t version = source.find("#version");
+    if (version != std::string::npos) {
+        const size_t lineEnd = source.find('\n', version);
+        insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+    }
+
+    // GLSL 3.30 and later number the line after "#line n" as n
+    size_t nextLine = 1;
+    for (size_t i = 0; i < insertAt; i++)
+        if (source[i] == '\n')
+            nextLine++;
+
+    std::string result = source.substr(0, insertAt);
+    if (!result.empty() && result.back() != '\n')
+        result += '\n';
+    result += defines;
+    result += "#line " + std::to_string(nextLine) + "\n";
+    result += source.substr(insertAt);
+    return result;
+}
+
+// Specialised builds of one program, keyed by a bitmask of features. VariantSources turns
+// the base sources into a variant's stages, typically by inserting #defines for the key, so
+// features are resolved by the preprocessor instead of branching at run time. A variant is
+// built when first drawn, or earlier in the background through prefetch(); combinations that
+// are never drawn are never compiled.
+class ShaderVariants {
+public:
+    using VariantSources = std::function<std::vector<ShaderSource>(uint32_t key, const std::vector<ShaderSource>& base)>;
+    using PrepareProgram = std::function<void(GLuint program)>;  // Run after every link or binary load
+
+    void init(std::string variantName, const ProgramCache& programCache, BackgroundProgramCompiler& programCompiler,
+              std::vector<ShaderSource> baseSources, VariantSources makeSources, PrepareProgram prepareProgram) {
+        name = std::move(variantName);
+        cache = &programCache;
+        compiler = &programCompiler;
+        sources = std::move(baseSources);
+        variantSources = std::move(makeSources);
+        prepare = std::move(prepareProgram);
+    }
+
+    // The variant for key, built through the ProgramCache on the spot if it is not ready yet
+    ShaderProgram& get(uint32_t key) {
+        Variant& variant = variants[key];
+        if (variant.program == 0) {
+            const std::vector<ShaderSource> stages = variantSources(key, sources);
+            const std::vector<ShaderStage> stageList = shaderStages(stages);
+            install(variant, cache->load(name + "-" + std::to_string(key), stageList.data(), stageList.size()));
+        }
+        return variant.uniforms;
+    }
+
+    // Starts a background build of a variant that is likely to be drawn soon; does nothing if
+    // it is built or on its way, or if the compiler cannot work in the background
+    void prefetch(uint32_t key) {
+        if (!compiler->background() || variants.count(key) != 0)
+            return;
+        variants[key];
+        queue(key);
+    }
+
+    // New base sources: every variant built so far is rebuilt in the background and keeps
+    // drawing with its old program until the new one has linked
+    void reload(std::vector<ShaderSource> baseSources) {
+        sources = std::move(baseSources);
+        generation++;
+        for (auto& entry : variants)
+            queue(entry.first);
+    }
+
+    // Swaps in the variants the compiler has finished; call once per frame before drawing
+    void update() {
+        uint64_t job;
+        GLuint program;
+        while (compiler->poll(job, program)) {
+            const uint32_t key = static_cast<uint32_t>(job);
+            const uint32_t jobGeneration = static_cast<uint32_t>(job >> 32);
+            auto it = variants.find(key);
+            // Stale: built from sources replaced since, or already built on demand by get()
+            if (it == variants.end() || jobGeneration != generation
+                || (it->second.program != 0 && it->second.generation == generation)) {
+                glDeleteProgram(program);
+                continue;
+            }
+            const bool reloaded = it->second.program != 0;
+            install(it->second, program);
+            if (reloaded)
+                std::cout << "Reloaded " << name << " variant " << key << std::endl;
+        }
+    }
+
+    size_t size() const {
+        return variants.size();
+    }
+
+    void destroy() {
+        for (auto& entry : variants)
+            if (entry.second.program != 0)
+                glDeleteProgram(entry.second.program);
+        variants.clear();
+    }
+
+private:
+    struct Variant {
+        GLuint program = 0;
+        uint32_t generation = 0;  // Of the sources the program was built from
+        ShaderProgram uniforms;
+    };
+
+    void queue(uint32_t key) {
+        compiler->compile(static_cast<uint64_t>(generation) << 32 | key, variantSources(key, sources));
+    }
+
+    void install(Variant& variant, GLuint program) {
+        if (variant.program != 0)
+            glDeleteProgram(variant.program);
+        variant.program = program;
+        variant.generation = generation;
+        prepare(program);
+        variant.uniforms.reset(program);
+    }
+
+    std::string name;
+    const ProgramCache* cache = nullptr;
+    BackgroundProgramCompiler* compiler = nullptr;
+    std::vector<ShaderSource> sources;
+    VariantSources variantSources;
+    PrepareProgram prepare;
+    uint32_t generation = 0;
+    std::unordered_map<uint32_t, Variant> variants;
+};
+
+#endif //SHADERVARIANTS_H
@@ -0,0 +1,394 @@
+#ifndef STREAMINGTERRAIN_H
+#define STREAMINGTERRAIN_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "BezierSurface.h"
+#include "BezierTessellator.h"
+#include "MeshOptimizer.h"
+#include "MeshletDraw.h"
+#include "Meshlets.h"
+#include "ThreadPool.h"
+#include "VertexFormat.h"
+
+// Unbounded terrain of bicubic Bezier patches, one per square chunk of the xz plane,
+// streamed in and out around the camera.
+//
+// The control points of all chunks come from one infinite lattice with CHUNK_SIZE / 3
+// spacing: heights are hashed value noise, and every junction point (lattice index a
+// multiple of 3) sits at the midpoint of its neighbours across the junction, so chunks
+// share their edge control points and join C1 without knowing about each other. Some
+// chunks get a diamond hole, tessellated by the same trimmed grid as the Lab4 plane.
+// Every chunk is quantized into a box that follows the chunk grid and the global height
+// range, so the shared edges of neighbours decode to exactly the same points.
+//
+// update() runs once per frame on the main thread. It wants every chunk within
+// loadRadius chunks of the camera plus a ring of aheadRadius around where the camera will
+// be lookaheadFrames from now, hands the closest missing ones to a private worker in small
+// batches (tessellation, mesh optimization, meshlets and packing all happen there),
+// uploads at most maxUploadsPerFrame finished chunks, and evicts the chunks farthest from
+// the camera that are no longer wanted whenever the GPU bytes would exceed
+// memoryBudgetBytes. Buffers of evicted chunks are reused for new ones.
+class StreamingTerrain {
+public:
+    static constexpr float CHUNK_SIZE = 8.0f;  // Power of two, so chunk corners are exact in float
+    static constexpr float HEIGHT_AMPLITUDE = 3.0f;
+
+    int loadRadius = 10;
+    int aheadRadius = 5;
+    float lookaheadFrames = 60.0f;
+    int samplesPerChunk = 33;
+    int batchSize = 4;
+    int maxUploadsPerFrame = 2;
+    size_t memoryBudgetBytes = 32u << 20;
+
+    explicit StreamingTerrain(uint32_t seed = 1) : seed(seed) {
+    }
+
+    StreamingTerrain(const StreamingTerrain&) = delete;
+    StreamingTerrain& operator=(const StreamingTerrain&) = delete;
+
+    // eye and velocity (per frame) in the terrain's model space
+    void update(const glm::vec3& eye, const glm::vec3& velocity) {
+        uploadReady();
+
+        if (busy.load())
+            return;
+
+        // Missing chunks, closest to the camera first
+        const glm::vec3 ahead = eye + velocity * lookaheadFrames;
+        std::vector<std::pair<float, ChunkKey>> missing;
+        forEachWanted(eye, ahead, [&](ChunkKey key, float distance) {
+            if (!chunks.count(key))
+                missing.push_back({distance, key});
+        });
+        if (missing.empty())
+            return;
+        std::sort(missing.begin(), missing.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        // Make room for the batch by dropping unwanted chunks, farthest first; chunks still
+        // waiting for upload count as resident
+        size_t fitting = std::min(missing.size(), static_cast<size_t>(batchSize));
+        while (residentBytes + (loadingChunks + fitting) * chunkBytesEstimate > memoryBudgetBytes) {
+            if (!evictFarthestUnwanted(eye, ahead)) {
+                const size_t used = residentBytes + loadingChunks * chunkBytesEstimate;
+                fitting = used < memoryBudgetBytes ? std::min(fitting, (memoryBudgetBytes - used) / chunkBytesEstimate) : 0;
+                break;
+            }
+        }
+        if (fitting == 0)
+            return;
+
+        std::vector<ChunkKey> batch;
+        for (size_t k = 0; k < fitting; k++) {
+            batch.push_back(missing[k].second);
+            chunks[missing[k].second].loading = true;
+        }
+        loadingChunks += batch.size();
+
+        busy = true;
+        worker.submit([this, batch = std::move(batch)] {
+            std::vector<ChunkMesh> meshes(batch.size());
+            ThreadPool::shared().parallelFor(static_cast<int>(batch.size()), [&](int begin, int end) {
+                for (int k = begin; k < end; k++)
+                    meshes[k] = generateChunk(batch[k]);
+            }, 1);
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            readyChunks.insert(readyChunks.end(), std::make_move_iterator(meshes.begin()),
+                               std::make_move_iterator(meshes.end()));
+            busy = false;
+        });
+    }
+
+    // Draws every resident chunk with the bound Frame and Object blocks and `program`,
+    // culling meshlets against `view` (terrain model space)
+    void draw(ShaderProgram& program, const MeshletView& view, MeshletDrawList& list) const {
+        for (const auto& entry : chunks) {
+            const Chunk& chunk = entry.second;
+            if (chunk.loading)
+                continue;
+
+            bool visible = true;
+            for (const glm::vec4& plane : view.planes)
+                visible = visible && glm::dot(glm::vec3(plane), chunk.center) + plane.w >= -chunk.radius;
+            if (!visible)
+                continue;
+
+            cullMeshlets(chunk.meshlets.data(), static_cast<int>(chunk.meshlets.size()), view, chunk.indexSize, list);
+            if (list.counts.empty())
+                continue;
+            setPositionDecodeUniforms(program, chunk.positionMin, chunk.positionScale);
+            glBindVertexArray(chunk.buffers.vao);
+            drawMeshlets(list, chunk.indexType);
+        }
+    }
+
+    size_t residentChunks() const {
+        return chunks.size();
+    }
+
+    size_t gpuBytes() const {
+        return residentBytes;
+    }
+
+    // Needs the GL context; waits for the worker first
+    void destroy() {
+        while (busy.load())
+            std::this_thread::yield();
+        for (auto& entry : chunks)
+            deleteBuffers(entry.second.buffers);
+        for (ChunkBuffers& buffers : freeBuffers)
+            deleteBuffers(buffers);
+        chunks.clear();
+        freeBuffers.clear();
+        readyChunks.clear();
+        residentBytes = 0;
+        loadingChunks = 0;
+    }
+
+private:
+    using ChunkKey = uint64_t;
+
+    struct ChunkBuffers {
+        GLuint vao = 0, vbo = 0, ebo = 0;
+    };
+
+    struct Chunk {
+        bool loading = false;  // Requested and not uploaded yet
+        ChunkBuffers buffers;
+        std::vector<Meshlet> meshlets;
+        glm::vec3 positionMin, positionScale;
+        glm::vec3 center;
+        float radius = 0.0f;
+        GLenum indexType = GL_UNSIGNED_SHORT;
+        GLsizeiptr indexSize = sizeof(uint16_t);
+        size_t bytes = 0;
+    };
+
+    struct ChunkMesh {
+        ChunkKey key = 0;
+        PackedMesh mesh;
+    };
+
+    static ChunkKey makeKey(int x, int z) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+    }
+
+    static int keyX(ChunkKey key) {
+        return static_cast<int32_t>(key >> 32);
+    }
+
+    static int keyZ(ChunkKey key) {
+        return static_cast<int32_t>(key & 0xffffffffu);
+    }
+
+    static glm::vec3 chunkCenter(ChunkKey key) {
+        return glm::vec3((keyX(key) + 0.5f) * CHUNK_SIZE, 0.0f, (keyZ(key) + 0.5f) * CHUNK_SIZE);
+    }
+
+    static float horizontalDistance(const glm::vec3& a, const glm::vec3& b) {
+        return glm::length(glm::vec2(a.x - b.x, a.z - b.z));
+    }
+
+    // body(key, distance to the camera) for every chunk within loadRadius of eye or
+    // aheadRadius of ahead
+    template <typename Body>
+    void forEachWanted(const glm::vec3& eye, const glm::vec3& ahead, Body&& body) const {
+        auto chunkOf = [](float coordinate) {
+            return static_cast<int>(std::floor(coordinate / CHUNK_SIZE));
+        };
+        const float loadDistance = loadRadius * CHUNK_SIZE, aheadDistance = aheadRadius * CHUNK_SIZE;
+        const int minX = std::min(chunkOf(eye.x) - loadRadius, chunkOf(ahead.x) - aheadRadius);
+        const int maxX = std::max(chunkOf(eye.x) + loadRadius, chunkOf(ahead.x) + aheadRadius);
+        const int minZ = std::min(chunkOf(eye.z) - loadRadius, chunkOf(ahead.z) - aheadRadius);
+        const int maxZ = std::max(chunkOf(eye.z) + loadRadius, chunkOf(ahead.z) + aheadRadius);
+        for (int x = minX; x <= maxX; x++) {
+            for (int z = minZ; z <= maxZ; z++) {
+                const ChunkKey key = makeKey(x, z);
+                const float distance = horizontalDistance(chunkCenter(key), eye);
+                if (distance <= loadDistance || horizontalDistance(chunkCenter(key), ahead) <= aheadDistance)
+                    body(key, distance);
+            }
+        }
+    }
+
+    bool wanted(ChunkKey key, const glm::vec3& eye, const glm::vec3& ahead) const {
+        return horizontalDistance(chunkCenter(key), eye) <= loadRadius * CHUNK_SIZE
+            || horizontalDistance(chunkCenter(key), ahead) <= aheadRadius * CHUNK_SIZE;
+    }
+
+    bool evictFarthestUnwanted(const glm::vec3& eye, const glm::vec3& ahead) {
+        auto farthest = chunks.end();
+        float farthestDistance = -1.0f;
+        for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+            const float distance = horizontalDistance(chunkCenter(it->first), eye);
+            if (!it->second.loading && distance > farthestDistance && !wanted(it->first, eye, ahead)) {
+                farthest = it;
+                farthestDistance = distance;
+            }
+        }
+        if (farthest == chunks.end())
+            return false;
+
+        residentBytes -= farthest->second.bytes;
+        freeBuffers.push_back(farthest->second.buffers);
+        chunks.erase(farthest);
+        return true;
+    }
+
+    void uploadReady() {
+        std::vector<ChunkMesh> uploads;
+        {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            const size_t count = std::min(readyChunks.size(), static_cast<size_t>(maxUploadsPerFrame));
+            uploads.assign(std::make_move_iterator(readyChunks.begin()), std::make_move_iterator(readyChunks.begin() + count));
+            readyChunks.erase(readyChunks.begin(), readyChunks.begin() + count);
+        }
+
+        for (ChunkMesh& result : uploads) {
+            Chunk& chunk = chunks[result.key];
+            const PackedMesh& mesh = result.mesh;
+            if (freeBuffers.empty()) {
+                glGenVertexArrays(1, &chunk.buffers.vao);
+                glGenBuffers(1, &chunk.buffers.vbo);
+                glGenBuffers(1, &chunk.buffers.ebo);
+            } else {
+                chunk.buffers = freeBuffers.back();
+                freeBuffers.pop_back();
+            }
+            uploadPackedMesh(chunk.buffers.vao, chunk.buffers.vbo, chunk.buffers.ebo, mesh, GL_STATIC_DRAW);
+
+            chunk.loading = false;
+            chunk.meshlets = mesh.meshlets;
+            chunk.positionMin = mesh.positionMin;
+            chunk.positionScale = mesh.positionScale;
+            chunk.center = mesh.positionMin + 0.5f * mesh.positionScale;
+            chunk.radius = 0.5f * glm::length(mesh.positionScale);
+            chunk.indexType = mesh.indexType();
+            chunk.indexSize = mesh.indexSize();
+            chunk.bytes = mesh.vertices.size() * sizeof(PackedVertex) + mesh.indexBytes();
+
+            residentBytes += chunk.bytes;
+            loadingChunks--;
+            chunkBytesEstimate = std::max(chunkBytesEstimate, chunk.bytes);
+        }
+    }
+
+    static void deleteBuffers(ChunkBuffers& buffers) {
+        glDeleteVertexArrays(1, &buffers.vao);
+        glDeleteBuffers(1, &buffers.vbo);
+        glDeleteBuffers(1, &buffers.ebo);
+    }
+
+    // Hash of a lattice point to [0, 1)
+    float hash(int i, int j, uint32_t salt) const {
+        uint32_t h = seed * 0x9E3779B1u ^ salt * 0x85EBCA77u;
+        h ^= static_cast<uint32_t>(i) * 0x27D4EB2Fu;
+        h = (h ^ (h >> 15)) * 0x2C1B3C6Du;
+        h ^= static_cast<uint32_t>(j) * 0x165667B1u;
+        h = (h ^ (h >> 12)) * 0x297A2D39u;
+        h ^= h >> 15;
+        return (h >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Smoothly interpolated hash on a grid `cell` lattice points wide, in [-1, 1]
+    float valueNoise(int i, int j, int cell, uint32_t salt) const {
+        auto cellOf = [&](int k) {
+            return k >= 0 ? k / cell : -((-k + cell - 1) / cell);
+        };
+        const int ci = cellOf(i), cj = cellOf(j);
+        const float s = glm::smoothstep(0.0f, 1.0f, static_cast<float>(i - ci * cell) / cell);
+        const float t = glm::smoothstep(0.0f, 1.0f, static_cast<float>(j - cj * cell) / cell);
+        const float a = glm::mix(hash(ci, cj, salt), hash(ci, cj + 1, salt), t);
+        const float b = glm::mix(hash(ci + 1, cj, salt), hash(ci + 1, cj + 1, salt), t);
+        return 2.0f * glm::mix(a, b, s) - 1.0f;
+    }
+
+    // Height of a free lattice point, within [-HEIGHT_AMPLITUDE, HEIGHT_AMPLITUDE]
+    float freeHeight(int i, int j) const {
+        const float noise = 0.6f * valueNoise(i, j, 24, 1) + 0.3f * valueNoise(i, j, 6, 2) + 0.1f * valueNoise(i, j, 1, 3);
+        return HEIGHT_AMPLITUDE * noise;
+    }
+
+    // Junctions are averages of free points, so they stay within the same range
+    float latticeHeight(int i, int j) const {
+        const bool junctionI = ((i % 3) + 3) % 3 == 0, junctionJ = ((j % 3) + 3) % 3 == 0;
+        if (junctionI && junctionJ)
+            return 0.25f * (freeHeight(i - 1, j - 1) + freeHeight(i - 1, j + 1) + freeHeight(i + 1, j - 1) + freeHeight(i + 1, j + 1));
+        if (junctionI)
+            return 0.5f * (freeHeight(i - 1, j) + freeHeight(i + 1, j));
+        if (junctionJ)
+            return 0.5f * (freeHeight(i, j - 1) + freeHeight(i, j + 1));
+        return freeHeight(i, j);
+    }
+
+    // Runs on the worker. Control point (a, b) of chunk (x, z) is lattice point
+    // (3z + a, 3x + b); as on the Lab4 plane, u runs along z and v along x.
+    ChunkMesh generateChunk(ChunkKey key) const {
+        const int x = keyX(key), z = keyZ(key);
+        glm::vec3 points[4][4];
+        for (int a = 0; a < 4; a++) {
+            for (int b = 0; b < 4; b++) {
+                const int i = 3 * z + a, j = 3 * x + b;
+                points[a][b] = glm::vec3(j * (CHUNK_SIZE / 3.0f), latticeHeight(i, j), i * (CHUNK_SIZE / 3.0f));
+            }
+        }
+        const BezierSurface surface(points);
+
+        DiamondTrim trim;
+        if (hash(x, z, 4) < 0.15f)
+            trim.radius = 0.15f + 0.15f * hash(x, z, 5);
+
+        const std::vector<float> uParams = trimAwareSamples(0.0f, 1.0f, samplesPerChunk, trim.centerU);
+        const std::vector<float> vParams = trimAwareSamples(0.0f, 1.0f, samplesPerChunk, trim.centerV);
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        tessellateTrimmedGrid(surface, trim, uParams, vParams, vertices, indices);
+
+        optimizeMesh(vertices, 6, indices);
+        std::vector<Meshlet> meshlets = buildMeshlets(indices, vertices, 6);
+        optimizeVertexFetch(vertices, 6, indices);
+
+        // Bezier patches stay inside the hull of their control points, so the box holds
+        ChunkMesh result;
+        result.key = key;
+        PackedMesh& mesh = result.mesh;
+        mesh.positionMin = glm::vec3(x * CHUNK_SIZE, -HEIGHT_AMPLITUDE, z * CHUNK_SIZE);
+        mesh.positionScale = glm::vec3(CHUNK_SIZE, 2.0f * HEIGHT_AMPLITUDE, CHUNK_SIZE);
+        const glm::vec3 inverseScale = inversePositionScale(mesh.positionScale);
+        mesh.vertices.resize(vertices.size() / 6);
+        for (size_t v = 0; v < mesh.vertices.size(); v++)
+            mesh.vertices[v] = packVertex(&vertices[v * 6], mesh.positionMin, inverseScale);
+        if (mesh.vertices.size() <= 65536)
+            mesh.shortIndices.assign(indices.begin(), indices.end());
+        else
+            mesh.intIndices.assign(indices.begin(), indices.end());
+        mesh.meshlets = std::move(meshlets);
+        return result;
+    }
+
+    uint32_t seed;
+    std::map<ChunkKey, Chunk> chunks;  // Resident and loading
+    std::vector<ChunkBuffers> freeBuffers;
+    size_t residentBytes = 0;
+    size_t loadingChunks = 0;
+    size_t chunkBytesEstimate = 64u << 10;  // Largest chunk seen so far
+
+    std::atomic<bool> busy{false};
+    std::mutex resultMutex;
+    std::vector<ChunkMesh> readyChunks;
+
+    // Declared last: destroyed first, so a running batch finishes while the members above still exist
+    ThreadPool worker{1};
+};
+
+#endif //STREAMINGTERRAIN_H
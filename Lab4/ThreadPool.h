@@ -0,0 +1,127 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size worker pool for the CPU-side geometry passes. parallelFor() cuts a range of
+// rows into contiguous bands; the calling thread works on bands too and returns once all
+// of them are done, so callers can treat it like an ordinary (blocking) loop.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1) {
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool shared by everything in the process
+    static ThreadPool& shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    unsigned int threadCount() const {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.push_back(std::move(task));
+        }
+        queueCondition.notify_one();
+    }
+
+    // Calls body(begin, end) for contiguous bands covering [0, count). Band boundaries depend
+    // only on count, so per-band results can be merged in band order deterministically.
+    template <typename Body>
+    void parallelFor(int count, Body&& body, int minBandSize = 8) {
+        if (count <= 0)
+            return;
+
+        const int maxBands = static_cast<int>(threadCount() + 1) * 4;
+        const int bandCount = std::min((count + minBandSize - 1) / minBandSize, maxBands);
+        if (bandCount <= 1 || workers.empty()) {
+            body(0, count);
+            return;
+        }
+
+        // Shared with the helper tasks, which may still be dequeued after all bands are taken
+        struct State {
+            std::atomic<int> nextBand{0};
+            std::atomic<int> remaining{0};
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+        auto state = std::make_shared<State>();
+        state->remaining = bandCount;
+
+        auto* bodyPtr = &body;
+        auto runBands = [state, bodyPtr, count, bandCount] {
+            for (int band; (band = state->nextBand.fetch_add(1)) < bandCount;) {
+                const int begin = static_cast<int>(static_cast<int64_t>(count) * band / bandCount);
+                const int end = static_cast<int>(static_cast<int64_t>(count) * (band + 1) / bandCount);
+                (*bodyPtr)(begin, end);
+
+                if (state->remaining.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->done.notify_all();
+                }
+            }
+        };
+
+        const int helpers = std::min(static_cast<int>(threadCount()), bandCount - 1);
+        for (int i = 0; i < helpers; i++)
+            submit(runBands);
+
+        runBands();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&] { return state->remaining.load() == 0; });
+    }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCondition.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool stopping = false;
+};
+
+#endif //THREADPOOL_H
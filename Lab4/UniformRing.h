@@ -0,0 +1,243 @@
+#ifndef UNIFORMRING_H
+#define UNIFORMRING_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+// Binding points of the uniform blocks shared by the scene shaders
+constexpr GLuint FRAME_BLOCK_BINDING = 0;
+constexpr GLuint OBJECT_BLOCK_BINDING = 1;
+
+// Lights in the Frame block; a shader variant uses the first LIGHT_COUNT of them
+constexpr int MAX_SCENE_LIGHTS = 4;
+
+// std140 layout of the Frame block: everything that is the same for every draw of a frame
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 viewPos;                       // xyz
+    glm::vec4 lightPos[MAX_SCENE_LIGHTS];    // xyz
+    glm::vec4 lightColor[MAX_SCENE_LIGHTS];  // rgb
+    glm::vec4 wireframeStyle;                // rgb: colour, a: line width in pixels
+    glm::vec4 fogStyle;                      // rgb: colour, a: density
+    glm::vec2 viewportSize;                  // Framebuffer size in pixels
+    glm::vec2 padding;
+};
+
+// std140 layout of the Object block. The normal matrix is a mat3, which std140 stores as
+// three vec4 columns.
+struct ObjectUniforms {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3];
+    glm::vec3 objectColor;
+    int32_t padding;
+};
+
+static_assert(sizeof(FrameUniforms) == 384, "FrameUniforms must match the std140 Frame block");
+static_assert(sizeof(ObjectUniforms) == 128, "ObjectUniforms must match the std140 Object block");
+
+// Object block contents for a model matrix; the inverse transpose is taken once here
+// instead of in the vertex shader for every vertex
+inline ObjectUniforms makeObjectUniforms(const glm::mat4& model, const glm::vec3& color) {
+    ObjectUniforms object;
+    object.model = model;
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    for (int column = 0; column < 3; column++)
+        object.normalMatrix[column] = glm::vec4(normalMatrix[column], 0.0f);
+    object.objectColor = color;
+    object.padding = 0;
+    return object;
+}
+
+// Points a program's named uniform block at a binding; done after every link or binary load,
+// since glProgramBinary restores the bindings to their link-time defaults
+inline void bindUniformBlock(GLuint program, const char* blockName, GLuint binding) {
+    const GLuint blockIndex = glGetUniformBlockIndex(program, blockName);
+    if (blockIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, blockIndex, binding);
+}
+
+// Uniform buffer used as a ring of FRAMES_IN_FLIGHT regions, one per frame. Blocks are
+// written into the current frame's region at increasing offsets and bound with
+// glBindBufferRange, so no block the GPU may still read is ever overwritten; a fence per
+// region makes beginFrame() wait only when the GPU is that many frames behind. The buffer is
+// persistently mapped where ARB_buffer_storage (GL 4.4) is available, and mapped per write
+// with GL_MAP_UNSYNCHRONIZED_BIT otherwise (GL 4.1, macOS). A frame that binds more than a
+// region holds moves the ring into a buffer with twice the region size; the blocks bound so
+// far are copied over, so no range that is still bound is ever written.
+class UniformRing {
+public:
+    static constexpr int FRAMES_IN_FLIGHT = 3;
+
+    bool init(GLsizeiptr bytesPerFrame) {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        offsetAlignment = static_cast<GLsizeiptr>(std::max(alignment, 1));
+        regionSize = align(bytesPerFrame);
+        return allocate();
+    }
+
+    // Moves to the next region, waiting for the GPU to finish the frame that last used it
+    void beginFrame() {
+        region = (region + 1) % FRAMES_IN_FLIGHT;
+        if (fences[region] != nullptr) {
+            waitAndDelete(fences[region]);
+            fences[region] = nullptr;
+        }
+        cursor = 0;
+        bound.clear();
+    }
+
+    // Fences the current region after the frame's last draw has been issued
+    void endFrame() {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // Copies a block into the current region and binds it to `binding`
+    template <typename Block>
+    void bind(GLuint binding, const Block& block) {
+        static_assert(std::is_trivially_copyable_v<Block>, "Uniform blocks are copied as raw bytes");
+        const GLsizeiptr size = sizeof(Block);
+        if (cursor + align(size) > regionSize)
+            grow(cursor + align(size));
+
+        const GLintptr offset = region * regionSize + cursor;
+        if (mapped != nullptr) {
+            std::memcpy(mapped + offset, &block, size);
+        } else {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            void* target = glMapBufferRange(GL_UNIFORM_BUFFER, offset, size,
+                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (target != nullptr) {
+                std::memcpy(target, &block, size);
+                glUnmapBuffer(GL_UNIFORM_BUFFER);
+            }
+        }
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+        cursor += align(size);
+        setBound(binding, offset, size);
+    }
+
+    void destroy() {
+        for (GLsync& fence : fences) {
+            if (fence != nullptr)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        release(buffer, mapped);
+        buffer = 0;
+        mapped = nullptr;
+    }
+
+private:
+    // Range of the current region bound to a binding point during this frame
+    struct BoundRange {
+        GLuint binding;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    bool allocate() {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        const GLsizeiptr capacity = regionSize * FRAMES_IN_FLIGHT;
+        if (GLEW_ARB_buffer_storage) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_UNIFORM_BUFFER, capacity, nullptr, flags);
+            mapped = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, capacity, flags));
+            if (mapped == nullptr)
+                std::cerr << "ERROR: Could not map the uniform ring buffer" << std::endl;
+        } else {
+            glBufferData(GL_UNIFORM_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        return GLEW_ARB_buffer_storage ? mapped != nullptr : true;
+    }
+
+    // Unmaps and deletes a buffer; GL keeps its storage until the draws queued on it are done
+    static void release(GLuint oldBuffer, unsigned char* oldMapped) {
+        if (oldBuffer == 0)
+            return;
+        if (oldMapped != nullptr) {
+            glBindBuffer(GL_UNIFORM_BUFFER, oldBuffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &oldBuffer);
+    }
+
+    // Moves the ring into a new buffer whose regions hold at least `needed` bytes. The blocks
+    // this frame has bound are copied to the start of the new current region on the GPU and
+    // bound again there; the old buffer is never written after this. Nothing the GPU may
+    // read lives in the new buffer yet, so its fences start out empty.
+    void grow(GLsizeiptr needed) {
+        GLsizeiptr newSize = regionSize;
+        while (newSize < needed)
+            newSize *= 2;
+        std::cout << "Uniform ring grown to " << newSize << " bytes per frame" << std::endl;
+
+        const GLuint oldBuffer = buffer;
+        unsigned char* const oldMapped = mapped;
+        for (GLsync& fence : fences) {
+            if (fence != nullptr)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        regionSize = align(newSize);
+        region = 0;
+        cursor = 0;
+        allocate();
+
+        glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        for (BoundRange& range : bound) {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.offset, cursor, range.size);
+            range.offset = cursor;
+            glBindBufferRange(GL_UNIFORM_BUFFER, range.binding, buffer, range.offset, range.size);
+            cursor += align(range.size);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        release(oldBuffer, oldMapped);
+    }
+
+    void setBound(GLuint binding, GLintptr offset, GLsizeiptr size) {
+        for (BoundRange& range : bound) {
+            if (range.binding == binding) {
+                range.offset = offset;
+                range.size = size;
+                return;
+            }
+        }
+        bound.push_back({binding, offset, size});
+    }
+
+    GLsizeiptr align(GLsizeiptr size) const {
+        return (size + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+    }
+
+    static void waitAndDelete(GLsync fence) {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        while (status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        glDeleteSync(fence);
+    }
+
+    GLuint buffer = 0;
+    unsigned char* mapped = nullptr;
+    GLsizeiptr offsetAlignment = 256;
+    GLsizeiptr regionSize = 0;
+    GLsizeiptr cursor = 0;
+    int region = 0;
+    GLsync fences[FRAMES_IN_FLIGHT] = {};
+    std::vector<BoundRange> bound;
+};
+
+#endif //UNIFORMRING_H
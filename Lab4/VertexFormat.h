@@ -0,0 +1,193 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Meshlets.h"
+#include "ShaderProgram.h"
+
+// Compact vertex layout for the generated meshes, 12 bytes instead of 6 floats (24 bytes):
+// the position as unorm16 x3 relative to the mesh bounds (the fourth short only pads the
+// normal onto a 4-byte boundary) and the unit normal octahedral-encoded as snorm16 x2.
+// vertexShaderSource decodes both.
+struct PackedVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+};
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex must stay tightly packed");
+
+inline int16_t toSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline uint16_t toUnorm16(float value) {
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+// Unit vector -> point in [-1, 1]^2: projected onto the octahedron |x| + |y| + |z| = 1,
+// with the lower half folded over the diagonals
+inline glm::vec2 encodeOctahedral(const glm::vec3& n) {
+    const glm::vec3 p = n / (std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z));
+    if (p.z >= 0.0f)
+        return glm::vec2(p.x, p.y);
+    return glm::vec2((1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                     (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+// Index range of one level of detail within a mesh's index buffer, and its meshlets
+struct MeshLevel {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;  // Largest distance to the surface the level approximates, in model units
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+};
+
+// Indexed mesh in PackedVertex format; indices are 16-bit whenever the vertex count allows
+struct PackedMesh {
+    std::vector<PackedVertex> vertices;
+    std::vector<uint16_t> shortIndices;
+    std::vector<uint32_t> intIndices;
+    std::vector<MeshLevel> levels;  // Coarsest first; empty when the mesh has a single level
+    std::vector<Meshlet> meshlets;  // Empty when the mesh is drawn whole
+
+    // Decoded position = positionMin + unorm position * positionScale
+    glm::vec3 positionMin = glm::vec3(0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f);
+
+    bool shortIndexed() const {
+        return intIndices.empty();
+    }
+
+    GLenum indexType() const {
+        return shortIndexed() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    GLsizei indexCount() const {
+        return static_cast<GLsizei>(shortIndexed() ? shortIndices.size() : intIndices.size());
+    }
+
+    GLsizeiptr indexSize() const {
+        return shortIndexed() ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    GLsizeiptr indexBytes() const {
+        return shortIndexed() ? shortIndices.size() * sizeof(uint16_t) : intIndices.size() * sizeof(uint32_t);
+    }
+
+    const void* indexData() const {
+        return shortIndexed() ? static_cast<const void*>(shortIndices.data()) : intIndices.data();
+    }
+};
+
+// 1 / positionScale per axis, 0 along axes where the mesh is flat
+inline glm::vec3 inversePositionScale(const glm::vec3& positionScale) {
+    glm::vec3 inverseScale;
+    for (int axis = 0; axis < 3; axis++)
+        inverseScale[axis] = positionScale[axis] > 0.0f ? 1.0f / positionScale[axis] : 0.0f;
+    return inverseScale;
+}
+
+// One position + normal vertex (6 floats) quantized into the box starting at positionMin
+inline PackedVertex packVertex(const float* source, const glm::vec3& positionMin, const glm::vec3& inverseScale) {
+    PackedVertex packed;
+    const glm::vec3 unit = (glm::vec3(source[0], source[1], source[2]) - positionMin) * inverseScale;
+    packed.position[0] = toUnorm16(unit.x);
+    packed.position[1] = toUnorm16(unit.y);
+    packed.position[2] = toUnorm16(unit.z);
+    packed.position[3] = 0;
+
+    const glm::vec2 octahedral = encodeOctahedral(glm::vec3(source[3], source[4], source[5]));
+    packed.normal[0] = toSnorm16(octahedral.x);
+    packed.normal[1] = toSnorm16(octahedral.y);
+    return packed;
+}
+
+// Packs an interleaved position + normal (6 floats per vertex) mesh
+inline PackedMesh packMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices) {
+    PackedMesh mesh;
+    const size_t vertexCount = vertices.size() / 6;
+
+    glm::vec3 low(0.0f), high(0.0f);
+    for (size_t v = 0; v < vertexCount; v++) {
+        const glm::vec3 p(vertices[v * 6], vertices[v * 6 + 1], vertices[v * 6 + 2]);
+        low = v == 0 ? p : glm::min(low, p);
+        high = v == 0 ? p : glm::max(high, p);
+    }
+    mesh.positionMin = low;
+    mesh.positionScale = high - low;
+
+    const glm::vec3 inverseScale = inversePositionScale(mesh.positionScale);
+    mesh.vertices.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        mesh.vertices[v] = packVertex(&vertices[v * 6], low, inverseScale);
+
+    if (vertexCount <= 65536)
+        mesh.shortIndices.assign(indices.begin(), indices.end());
+    else
+        mesh.intIndices.assign(indices.begin(), indices.end());
+    return mesh;
+}
+
+// Decoded positions of packed vertices, the same quantized points the vertex shader draws
+inline std::vector<glm::vec3> decodePackedPositions(const PackedVertex* vertices, size_t vertexCount,
+                                                    const glm::vec3& positionMin, const glm::vec3& positionScale) {
+    std::vector<glm::vec3> positions(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        const glm::vec3 unit(vertices[v].position[0], vertices[v].position[1], vertices[v].position[2]);
+        positions[v] = positionMin + unit / 65535.0f * positionScale;
+    }
+    return positions;
+}
+
+// indices[firstIndex, firstIndex + indexCount) of a 16- or 32-bit index buffer, widened
+inline std::vector<uint32_t> widenIndices(const void* indexData, GLenum indexType, size_t firstIndex, size_t indexCount) {
+    std::vector<uint32_t> indices(indexCount);
+    for (size_t i = 0; i < indexCount; i++) {
+        indices[i] = indexType == GL_UNSIGNED_SHORT ? static_cast<const uint16_t*>(indexData)[firstIndex + i]
+                                                    : static_cast<const uint32_t*>(indexData)[firstIndex + i];
+    }
+    return indices;
+}
+
+// Uploads PackedVertex and index data into vbo/ebo and points the attributes of vao at it
+// (location 0: position, location 1: normal)
+inline void uploadPackedBuffers(GLuint vao, GLuint vbo, GLuint ebo, const void* vertexData, GLsizeiptr vertexBytes,
+                                const void* indexData, GLsizeiptr indexBytes, GLenum usage) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, usage);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, usage);
+
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+inline void uploadPackedMesh(GLuint vao, GLuint vbo, GLuint ebo, const PackedMesh& mesh, GLenum usage) {
+    uploadPackedBuffers(vao, vbo, ebo, mesh.vertices.data(), mesh.vertices.size() * sizeof(PackedVertex),
+                        mesh.indexData(), mesh.indexBytes(), usage);
+}
+
+// Position decode constants of a mesh, for the program that draws it
+inline void setPositionDecodeUniforms(ShaderProgram& program, const glm::vec3& positionMin, const glm::vec3& positionScale) {
+    program.set("positionMin", positionMin);
+    program.set("positionScale", positionScale);
+}
+
+inline void setPackedMeshUniforms(ShaderProgram& program, const PackedMesh& mesh) {
+    setPositionDecodeUniforms(program, mesh.positionMin, mesh.positionScale);
+}
+
+#endif //VERTEXFORMAT_H
@@ -5,66 +5,35 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <cmath>
-#include <map>
 #include <vector>
+#include <string>
+#include "BezierLod.h"
+#include "BezierPatchRenderer.h"
+#include "BezierTessellator.h"
+#include "EPlaneMode.h"
+#include "MeshBvh.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshletDraw.h"
+#include "Meshlets.h"
+#include "MultiPatchSurface.h"
+#include "ShaderCache.h"
+#include "ShaderProgram.h"
+#include "ShaderReload.h"
+#include "ShaderVariants.h"
+#include "SphereGenerators.h"
+#include "StreamingTerrain.h"
+#include "UniformRing.h"
+#include "VertexFormat.h"
 
 const int SCR_WIDTH = 800;
 const int SCR_HEIGHT = 800;
 
-const char* vertexShaderSource = R"(
-    #version 330 core
-    layout (location = 0) in vec3 aPos;
-    layout (location = 1) in vec3 aNormal;
-
-    out vec3 FragPos;
-    out vec3 Normal;
-
-    uniform mat4 projection;
-    uniform mat4 view;
-    uniform mat4 model;
-
-    void main() {
-        FragPos = vec3(model * vec4(aPos, 1.0));
-        Normal = mat3(transpose(inverse(model))) * aNormal;
-
-        gl_Position = projection * view * model * vec4(aPos, 1.0);
-    }
-)";
-
-const char* fragmentShaderSource = R"(
-    #version 330 core
-    out vec4 FragColor;
-
-    in vec3 FragPos;
-    in vec3 Normal;
-
-    uniform vec3 lightPos;
-    uniform vec3 viewPos;
-    uniform vec3 lightColor;
-    uniform vec3 objectColor;
-
-    void main() {
-        // Ambient lighting
-        float ambientStrength = 0.1;
-        vec3 ambient = ambientStrength * lightColor;
-
-        // Diffuse lighting
-        vec3 norm = normalize(Normal);
-        vec3 lightDir = normalize(lightPos - FragPos);
-        float diff = max(dot(norm, lightDir), 0.0);
-        vec3 diffuse = diff * lightColor;
-
-        // Specular lighting
-        float specularStrength = 0.5;
-        vec3 viewDir = normalize(viewPos - FragPos);
-        vec3 reflectDir = reflect(-lightDir, norm);
-        float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-        vec3 specular = specularStrength * spec * lightColor;
-
-        vec3 result = (ambient + diffuse + specular) * objectColor;
-        FragColor = vec4(result, 1.0);
-    }
-)";
+// Directory of the scene shaders. CMake points it at the source tree, so that saving a shader
+// there rebuilds the program while the lab runs.
+#ifndef LAB4_SHADER_DIR
+#define LAB4_SHADER_DIR "shaders"
+#endif
 
 struct Camera {
     glm::vec3 position;
@@ -93,8 +62,16 @@ Camera camera = {
 
 bool usePerspective = true;
 float orthogonalSize = 10.0f;
-
-int binomialCoef(int n, int k);
+EPlaneMode planeMode = EPlaneMode::Adaptive;
+bool hardwareTessellationAvailable = false;
+bool sphereWireframe = true;
+bool planeWireframe = false;
+bool fogEnabled = false;
+int lightCount = 1;  // Lights the scene shader uses, up to MAX_SCENE_LIGHTS
+bool pickRequested = false;
+bool terrainEnabled = false;
+float sculptDirection = 0.0f;  // +1 / -1 while the surface is being raised / lowered
+const float cameraRadius = 0.1f;  // Size of the camera for collisions with the meshes
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     if (camera.firstMouse) {
@@ -128,25 +105,12 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 
 // Bezier curve function: B(t) = (1-t)³P₀ + 3(1-t)²tP₁ + 3(1-t)t²P₂ + t³P₃
 glm::vec3 bezierCurve(float t, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3) {
-    float u = 1.0f - t;
-    float tt = t * t;
-    float uu = u * u;
-    float uuu = uu * u;
-    float ttt = tt * t;
-
-    glm::vec3 point = uuu * p0;              // (1-t)³ * P₀
-    point += 3.0f * uu * t * p1;             // 3(1-t)² * t * P₁
-    point += 3.0f * u * tt * p2;             // 3(1-t) * t² * P₂
-    point += ttt * p3;                       // t³ * P₃
-
-    return point;
+    const glm::vec3 points[4] = { p0, p1, p2, p3 };
+    return bezierPoint(t, points);
 }
 
-void generateBezierPlane(std::vector<float>& vertices, std::vector<unsigned int>& indices,
-                         int resolution = 20, float size = 2.0f) {
-    float step = 1.0f / (resolution - 1);
-    float holeSize = size * 0.4f;  // Diamond hole size
-
+// Bicubic patch spanning [-size, size] in x and z with a raised middle
+BezierSurface makeBezierPlaneSurface(float size = 2.0f) {
     // Control points for the Bezier surface
     glm::vec3 controlPoints[4][4] = {
         { glm::vec3(-size, 0.0f, -size), glm::vec3(-size/3, 0.5f, -size), glm::vec3(size/3, 0.5f, -size), glm::vec3(size, 0.0f, -size) },
@@ -154,319 +118,94 @@ void generateBezierPlane(std::vector<float>& vertices, std::vector<unsigned int>
         { glm::vec3(-size, 0.5f, size/3), glm::vec3(-size/3, 1.0f, size/3), glm::vec3(size/3, 1.0f, size/3), glm::vec3(size, 0.5f, size/3) },
         { glm::vec3(-size, 0.0f, size), glm::vec3(-size/3, 0.5f, size), glm::vec3(size/3, 0.5f, size), glm::vec3(size, 0.0f, size) }
     };
+    return BezierSurface(controlPoints);
+}
 
-    auto bernstein3 = [](int i, float t) {
-        float u = 1.0f - t;
-
-        switch (i) {
-            case 0: return u * u * u;
-            case 1: return 3.0f * u * u * t;
-            case 2: return 3.0f * u * t * t;
-            case 3: return t * t * t;
-            default: return 0.0f;
-        }
-    };
-
-    // First pass: compute all surface points
-    std::vector<glm::vec3> surfacePoints(resolution * resolution);
-    std::vector<bool> insideHole(resolution * resolution, false);
-
-    for (int i = 0; i < resolution; i++) {
-        float u = i * step;
-        for (int j = 0; j < resolution; j++) {
-            float v = j * step;
-            int idx = i * resolution + j;
-            glm::vec3 point(0.0f);
-
-            // Compute Bezier surface point using specialized formula
-            for (int ki = 0; ki <= 3; ki++) {
-                float bu = bernstein3(ki, u);
-                for (int kj = 0; kj <= 3; kj++) {
-                    float bv = bernstein3(kj, v);
-                    point += controlPoints[ki][kj] * (bu * bv);
-                }
-            }
-            surfacePoints[idx] = point;
-
-            // Strict diamond hole boundary using Manhattan distance
-            float manhattanDist = fabs(point.x) + fabs(point.z);
-            insideHole[idx] = (manhattanDist < holeSize);
-        }
-    }
-
-    // Second pass: identify boundary points
-    std::vector<bool> isBoundaryPoint(resolution * resolution, false);
-
-    for (int i = 0; i < resolution; i++) {
-        for (int j = 0; j < resolution; j++) {
-            int idx = i * resolution + j;
-            if (insideHole[idx]) continue;
-
-            // Check if this point is adjacent to a hole point
-            for (int di = -1; di <= 1; di++) {
-                for (int dj = -1; dj <= 1; dj++) {
-                    if (di == 0 && dj == 0) continue;
-
-                    int ni = i + di;
-                    int nj = j + dj;
-
-                    if (ni >= 0 && ni < resolution && nj >= 0 && nj < resolution) {
-                        int neighborIdx = ni * resolution + nj;
-                        if (insideHole[neighborIdx]) {
-                            isBoundaryPoint[idx] = true;
-                            break;
-                        }
-                    }
-                }
-                if (isBoundaryPoint[idx]) break;
-            }
-        }
-    }
-
-    // Third pass: Calculate normals with special handling for boundary points
-    std::vector<glm::vec3> surfaceNormals(resolution * resolution);
-
-    for (int i = 0; i < resolution; i++) {
-        for (int j = 0; j < resolution; j++) {
-            int idx = i * resolution + j;
-            if (insideHole[idx]) continue;
-
-            // Calculate the tangent vectors
-            glm::vec3 tangentU, tangentV;
-
-            if (i == 0)
-                tangentU = surfacePoints[(i + 1) * resolution + j] - surfacePoints[i * resolution + j];
-            else if (i == resolution - 1)
-                tangentU = surfacePoints[i * resolution + j] - surfacePoints[(i - 1) * resolution + j];
-            else
-                tangentU = surfacePoints[(i + 1) * resolution + j] - surfacePoints[(i - 1) * resolution + j];
-
-            if (j == 0)
-                tangentV = surfacePoints[i * resolution + j + 1] - surfacePoints[i * resolution + j];
-            else if (j == resolution - 1)
-                tangentV = surfacePoints[i * resolution + j] - surfacePoints[i * resolution + j - 1];
-            else
-                tangentV = surfacePoints[i * resolution + j + 1] - surfacePoints[i * resolution + j - 1];
-
-            // Compute normal from tangents
-            if (glm::length(tangentU) < 0.0001f || glm::length(tangentV) < 0.0001f) {
-                surfaceNormals[idx] = glm::vec3(0.0f, 1.0f, 0.0f);
-            } else {
-                surfaceNormals[idx] = glm::normalize(glm::cross(tangentU, tangentV));
-
-                // Special handling for boundary points - direct normals toward hole center
-                if (isBoundaryPoint[idx]) {
-                    glm::vec3 point = surfacePoints[idx];
-                    // Vector from origin to point projected on XZ plane
-                    glm::vec3 fromCenter = glm::normalize(glm::vec3(point.x, 0.0f, point.z));
-
-                    // Blend normal with outward direction for sharp edge
-                    glm::vec3 upVector = glm::vec3(0.0f, 1.0f, 0.0f);
-                    glm::vec3 outwardNormal = glm::normalize(fromCenter + 0.5f * upVector);
-
-                    // Strong blend toward the outward direction for boundary points
-                    surfaceNormals[idx] = glm::normalize(surfaceNormals[idx] * 0.2f + outwardNormal * 0.8f);
-                }
-            }
-        }
-    }
-
-    // Fourth pass: Create exact boundary vertices along the diamond edge
-    std::map<std::pair<int, int>, int> edgeVertexMap;  // Maps edge indices to vertex indices
-    int vertexCount = 0;
-
-    // Add all non-hole vertices first
-    for (int i = 0; i < resolution; i++) {
-        for (int j = 0; j < resolution; j++) {
-            int idx = i * resolution + j;
-            if (insideHole[idx]) continue;
-
-            // Add vertex
-            vertices.push_back(surfacePoints[idx].x);
-            vertices.push_back(surfacePoints[idx].y);
-            vertices.push_back(surfacePoints[idx].z);
-            vertices.push_back(surfaceNormals[idx].x);
-            vertices.push_back(surfaceNormals[idx].y);
-            vertices.push_back(surfaceNormals[idx].z);
-
-            edgeVertexMap[{i, j}] = vertexCount++;
-        }
-    }
+// Diamond hole of the plane. The patch maps u linearly onto z and v onto x, so the world-space
+// hole |x| + |z| < holeSize is the parameter-space diamond around (0.5, 0.5) with radius
+// holeSize / (2 * size)
+DiamondTrim makeBezierPlaneTrim(float size = 2.0f) {
+    float holeSize = size * 0.4f;  // Diamond hole size
 
-    // Generate triangles while properly handling the hole
-    for (int i = 0; i < resolution - 1; i++) {
-        for (int j = 0; j < resolution - 1; j++) {
-            // Get quad corner indices
-            std::pair<int, int> p00 = {i, j};
-            std::pair<int, int> p10 = {i+1, j};
-            std::pair<int, int> p01 = {i, j+1};
-            std::pair<int, int> p11 = {i+1, j+1};
-
-            // Get vertex indices, -1 if inside hole
-            int v00 = insideHole[i * resolution + j] ? -1 : edgeVertexMap[p00];
-            int v10 = insideHole[(i+1) * resolution + j] ? -1 : edgeVertexMap[p10];
-            int v01 = insideHole[i * resolution + j+1] ? -1 : edgeVertexMap[p01];
-            int v11 = insideHole[(i+1) * resolution + j+1] ? -1 : edgeVertexMap[p11];
-
-            // Count how many vertices are valid
-            int validCount = (v00 != -1 ? 1 : 0) + (v10 != -1 ? 1 : 0) +
-                            (v01 != -1 ? 1 : 0) + (v11 != -1 ? 1 : 0);
-
-            // Only create triangles if we have 3 or 4 valid vertices
-            if (validCount == 4) {
-                // Standard quad triangulation
-                indices.push_back(v00);
-                indices.push_back(v10);
-                indices.push_back(v01);
-
-                indices.push_back(v01);
-                indices.push_back(v10);
-                indices.push_back(v11);
-            }
-            else if (validCount == 3) {
-                // Single triangle for a partial quad
-                if (v00 != -1 && v10 != -1 && v01 != -1) {
-                    indices.push_back(v00);
-                    indices.push_back(v10);
-                    indices.push_back(v01);
-                }
-                else if (v10 != -1 && v01 != -1 && v11 != -1) {
-                    indices.push_back(v10);
-                    indices.push_back(v11);
-                    indices.push_back(v01);
-                }
-                else if (v00 != -1 && v01 != -1 && v11 != -1) {
-                    indices.push_back(v00);
-                    indices.push_back(v11);
-                    indices.push_back(v01);
-                }
-                else if (v00 != -1 && v10 != -1 && v11 != -1) {
-                    indices.push_back(v00);
-                    indices.push_back(v10);
-                    indices.push_back(v11);
-                }
-            }
-        }
-    }
+    DiamondTrim trim;
+    trim.radius = holeSize / (2.0f * size);
+    return trim;
 }
 
+void generateBezierPlane(std::vector<float>& vertices, std::vector<unsigned int>& indices,
+                         int resolution = 20, float size = 2.0f) {
+    const BezierSurface surface = makeBezierPlaneSurface(size);
+    const DiamondTrim trim = makeBezierPlaneTrim(size);
 
-int binomialCoef(int n, int k) {
-    // C(n,k) = C(n,n-k)
-    if (k > n - k)
-        k = n - k;
-
-    if (k == 0)
-        return 1;
+    // Sample lines through the diamond's corners keep the trim linear inside every cell
+    const std::vector<float> uParams = trimAwareSamples(0.0f, 1.0f, resolution, trim.centerU);
+    const std::vector<float> vParams = trimAwareSamples(0.0f, 1.0f, resolution, trim.centerV);
 
-    int result = 1;
-    for (int i = 0; i < k; ++i) {
-        result *= (n - i);
-        result /= (i + 1);
-    }
-
-    return result;
+    tessellateTrimmedGrid(surface, trim, uParams, vParams, vertices, indices);
 }
 
-void generateSphereVertices(std::vector<float>& vertices, float radius, unsigned int sectorCount, unsigned int stackCount) {
-    float x, y, z, xy;
-    float nx, ny, nz;
-    float sectorStep = 2 * glm::pi<float>() / sectorCount;
-    float stackStep = glm::pi<float>() / stackCount;
-    float sectorAngle, stackAngle;
-
-    for (unsigned int i = 0; i <= stackCount; ++i) {
-        stackAngle = glm::pi<float>() / 2 - i * stackStep;
-        xy = radius * cosf(stackAngle);
-        z = radius * sinf(stackAngle);
-
-        // Vertices of the current stack
-        for (unsigned int j = 0; j <= sectorCount; ++j) {
-            sectorAngle = j * sectorStep;
-
-            x = xy * cosf(sectorAngle);
-            y = xy * sinf(sectorAngle);
-
-            // Normalized vertex normal (pointing outward from the sphere center)
-            nx = x / radius;
-            ny = y / radius;
-            nz = z / radius;
-
-            // Position
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
-
-            // Normal
-            vertices.push_back(nx);
-            vertices.push_back(ny);
-            vertices.push_back(nz);
-        }
-    }
+// Stages of the scene program, read from LAB4_SHADER_DIR
+std::vector<ShaderSource> sceneShaderSources() {
+    return {
+        {GL_VERTEX_SHADER, "scene.vert", ""},
+        {GL_GEOMETRY_SHADER, "scene.geom", ""},
+        {GL_FRAGMENT_SHADER, "scene.frag", ""},
+    };
 }
 
-void generateSphereIndices(std::vector<unsigned int>& indices, unsigned int sectorCount, unsigned int stackCount) {
-    unsigned int k1, k2;
-    for (unsigned int i = 0; i < stackCount; ++i) {
-        k1 = i * (sectorCount + 1);
-        k2 = k1 + sectorCount + 1;
-
-        for (unsigned int j = 0; j < sectorCount; ++j, ++k1, ++k2) {
-            if (i != 0) {
-                indices.push_back(k1);
-                indices.push_back(k2);
-                indices.push_back(k1 + 1);
-            }
+// Feature bits of a scene shader variant. Bits 2-3 hold the light count minus one.
+constexpr uint32_t SCENE_WIREFRAME = 1u << 0;
+constexpr uint32_t SCENE_FOG = 1u << 1;
+constexpr int SCENE_LIGHT_COUNT_SHIFT = 2;
 
-            if (i != (stackCount - 1)) {
-                indices.push_back(k1 + 1);
-                indices.push_back(k2);
-                indices.push_back(k2 + 1);
-            }
-        }
-    }
+uint32_t sceneVariantKey(bool wireframe, bool fog, int lights) {
+    return (wireframe ? SCENE_WIREFRAME : 0u) | (fog ? SCENE_FOG : 0u)
+         | static_cast<uint32_t>(lights - 1) << SCENE_LIGHT_COUNT_SHIFT;
 }
 
-GLuint compileShader(GLenum type, const char* source) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, nullptr);
-    glCompileShader(shader);
-
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        std::cerr << "ERROR: Shader compilation failed\n" << infoLog << std::endl;
+// Stages of one scene variant: each feature in the key becomes a #define, and only the
+// wireframe overlay needs the geometry shader's edge distances
+std::vector<ShaderSource> sceneVariantSources(uint32_t key, const std::vector<ShaderSource>& base) {
+    std::string defines = "#define MAX_LIGHTS " + std::to_string(MAX_SCENE_LIGHTS) + "\n";
+    defines += "#define LIGHT_COUNT " + std::to_string((key >> SCENE_LIGHT_COUNT_SHIFT) + 1) + "\n";
+    if (key & SCENE_WIREFRAME)
+        defines += "#define WIREFRAME\n";
+    if (key & SCENE_FOG)
+        defines += "#define FOG\n";
+
+    std::vector<ShaderSource> stages;
+    for (const ShaderSource& stage : base) {
+        if (stage.type == GL_GEOMETRY_SHADER && !(key & SCENE_WIREFRAME))
+            continue;
+        stages.push_back({stage.type, stage.fileName, insertDefines(stage.source, defines)});
     }
-    return shader;
+    return stages;
 }
 
-GLuint createShaderProgram() {
-    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
-    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
-
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    GLint success;
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-        std::cerr << "ERROR: Shader program linking failed\n" << infoLog << std::endl;
-    }
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+// Variants one key press away from key, built in the background so that toggling a feature
+// does not wait for a compile
+void prefetchSceneNeighbours(ShaderVariants& variants, uint32_t key) {
+    const int lights = static_cast<int>(key >> SCENE_LIGHT_COUNT_SHIFT) + 1;
+    variants.prefetch(key ^ SCENE_WIREFRAME);
+    variants.prefetch(key ^ SCENE_FOG);
+    variants.prefetch(sceneVariantKey(key & SCENE_WIREFRAME, key & SCENE_FOG, lights % MAX_SCENE_LIGHTS + 1));
+}
 
-    return shaderProgram;
+// Uniform block bindings are reset by every link and binary load
+void bindSceneBlocks(GLuint program) {
+    bindUniformBlock(program, "Frame", FRAME_BLOCK_BINDING);
+    bindUniformBlock(program, "Object", OBJECT_BLOCK_BINDING);
 }
 
 void processInput(GLFWwindow *window, Camera &camera) {
     static bool fPressed = false;
+    static bool tPressed = false;
+    static bool gPressed = false;
+    static bool hPressed = false;
+    static bool lPressed = false;
+    static bool oPressed = false;
+    static bool kPressed = false;
+    static bool mousePressed = false;
 
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -487,6 +226,12 @@ void processInput(GLFWwindow *window, Camera &camera) {
         camera.position += camera.up * speed;
     if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
         camera.position -= camera.up * speed;
+
+    sculptDirection = 0.0f;
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+        sculptDirection += 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+        sculptDirection -= 1.0f;
     if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
         if (!fPressed) {
             usePerspective = !usePerspective;
@@ -495,6 +240,97 @@ void processInput(GLFWwindow *window, Camera &camera) {
     } else {
         fPressed = false;
     }
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
+        if (!tPressed) {
+            // Cycle adaptive -> fixed grid -> tessellation shaders (when available) -> sculpt
+            if (planeMode == EPlaneMode::Adaptive)
+                planeMode = EPlaneMode::FixedGrid;
+            else if (planeMode == EPlaneMode::FixedGrid && hardwareTessellationAvailable)
+                planeMode = EPlaneMode::Hardware;
+            else if (planeMode != EPlaneMode::Sculpt)
+                planeMode = EPlaneMode::Sculpt;
+            else
+                planeMode = EPlaneMode::Adaptive;
+
+            const char* modeNames[] = {"fixed grid", "adaptive", "tessellation shaders", "sculpt (Up/Down edit)"};
+            std::cout << "Plane tessellation: " << modeNames[static_cast<int>(planeMode)] << std::endl;
+            tPressed = true;
+        }
+    } else {
+        tPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
+        if (!gPressed) {
+            sphereWireframe = !sphereWireframe;
+            std::cout << "Sphere wireframe: " << (sphereWireframe ? "on" : "off") << std::endl;
+            gPressed = true;
+        }
+    } else {
+        gPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) {
+        if (!hPressed) {
+            planeWireframe = !planeWireframe;
+            std::cout << "Plane wireframe: " << (planeWireframe ? "on" : "off") << std::endl;
+            hPressed = true;
+        }
+    } else {
+        hPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) {
+        if (!lPressed) {
+            terrainEnabled = !terrainEnabled;
+            std::cout << "Streaming terrain: " << (terrainEnabled ? "on" : "off") << std::endl;
+            lPressed = true;
+        }
+    } else {
+        lPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
+        if (!oPressed) {
+            fogEnabled = !fogEnabled;
+            std::cout << "Fog: " << (fogEnabled ? "on" : "off") << std::endl;
+            oPressed = true;
+        }
+    } else {
+        oPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) {
+        if (!kPressed) {
+            lightCount = lightCount % MAX_SCENE_LIGHTS + 1;
+            std::cout << "Lights: " << lightCount << std::endl;
+            kPressed = true;
+        }
+    } else {
+        kPressed = false;
+    }
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+        if (!mousePressed) {
+            pickRequested = true;
+            mousePressed = true;
+        }
+    } else {
+        mousePressed = false;
+    }
+}
+
+// Ray against a mesh placed by `model`; the ray is moved into model space, where the BVH
+// lives, and hit.distance stays in world units as long as the model does not scale
+bool pickMesh(const MeshBvh& bvh, const glm::mat4& model, const glm::vec3& origin, const glm::vec3& direction,
+              RayHit& hit) {
+    const glm::mat4 inverseModel = glm::inverse(model);
+    const Ray ray = {glm::vec3(inverseModel * glm::vec4(origin, 1.0f)), glm::vec3(inverseModel * glm::vec4(direction, 0.0f))};
+    return bvh.intersect(ray, hit);
+}
+
+// Positions of the sculpted plane as drawn, for its BVH
+std::vector<glm::vec3> decodeSculptPositions(const MultiPatchSurface& surface) {
+    const PackedMesh& mesh = surface.packedMesh();
+    return decodePackedPositions(mesh.vertices.data(), mesh.vertices.size(), mesh.positionMin, mesh.positionScale);
+}
+
+bool meshTouchesSphere(const MeshBvh& bvh, const glm::mat4& model, const glm::vec3& center, float radius) {
+    return bvh.overlapsSphere(glm::vec3(glm::inverse(model) * glm::vec4(center, 1.0f)), radius);
 }
 
 glm::mat4 getViewMatrix(const Camera &camera) {
@@ -507,11 +343,19 @@ int main() {
         return -1;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // GL 4.1 for the tessellation-shader plane (the highest core version macOS offers),
+    // falling back to 3.3 without it
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGL Sphere & Bezier Plane with Diamond Hole", nullptr, nullptr);
+    if (!window) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGL Sphere & Bezier Plane with Diamond Hole", nullptr, nullptr);
+    }
     if (!window) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -529,100 +373,226 @@ int main() {
 
     glEnable(GL_DEPTH_TEST);
 
-    GLuint shaderProgram = createShaderProgram();
-
-    // Create sphere
-    std::vector<float> sphereVertices;
-    std::vector<unsigned int> sphereIndices;
-    generateSphereVertices(sphereVertices, 1.0f, 36, 18);
-    generateSphereIndices(sphereIndices, 36, 18);
+    std::vector<ShaderSource> sceneSources = sceneShaderSources();
+    if (!readShaderSources(LAB4_SHADER_DIR, sceneSources)) {
+        glfwTerminate();
+        return -1;
+    }
+    ProgramCache programCache("shader_cache");
+
+    // Saved shader files are rebuilt in the background; the current programs keep drawing
+    // until the new ones have linked. The builds run on a worker thread with the context of a
+    // hidden window, which shares objects with this one.
+    ShaderFileWatcher shaderWatcher;
+    shaderWatcher.init(LAB4_SHADER_DIR, sceneSources);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* compileContext = glfwCreateWindow(1, 1, "Shader compiler", nullptr, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    BackgroundProgramCompiler shaderCompiler;
+    if (compileContext)
+        shaderCompiler.init([compileContext] { glfwMakeContextCurrent(compileContext); },
+                            [] { glfwMakeContextCurrent(nullptr); });
+    else
+        shaderCompiler.init(nullptr, nullptr);
+
+    // Scene shader specialised per feature combination, built the first time it is drawn
+    ShaderVariants sceneVariants;
+    sceneVariants.init("scene", programCache, shaderCompiler, sceneSources, sceneVariantSources, bindSceneBlocks);
+
+    // Frame and object blocks of every draw, written into a ring the GPU reads behind
+    UniformRing uniformRing;
+    uniformRing.init(16 * 1024);
+
+    // Same plane drawn from its 16 control points by the tessellation stages
+    BezierPatchRenderer patchRenderer;
+    hardwareTessellationAvailable = BezierPatchRenderer::isSupported()
+                                 && patchRenderer.init(programCache, makeBezierPlaneSurface(2.0f),
+                                                       makeBezierPlaneTrim(2.0f));
+
+    // Generated meshes are kept in packed form in mesh_cache/ and mapped from there on later runs
+    MeshCache meshCache("mesh_cache");
+
+    // Create sphere: an icosphere with all its levels of detail in one buffer, the level drawn is
+    // picked per frame from the sphere's size on screen
+    const float sphereRadius = 1.0f;
+    const int sphereMaxLevel = 5;
+    const MeshCacheKey sphereKey = MeshCacheKey("icosphere").add(sphereRadius).add(sphereMaxLevel);
+    const CachedMesh sphereMesh = meshCache.load(sphereKey, [&] {
+        const SphereLodChain chain = generateIcosphere(sphereMaxLevel, false);
+        std::vector<float> sphereVertices = chain.positionNormalVertices(sphereRadius);
+        std::vector<unsigned int> sphereIndices = chain.indices;
+
+        // Each level is cache-ordered and split into meshlets on its own, so the level ranges stay intact
+        std::vector<MeshLevel> levels;
+        std::vector<Meshlet> meshlets;
+        for (const SphereLodChain::Level& level : chain.levels) {
+            const std::string levelName = "Sphere level " + std::to_string(levels.size());
+            printMeshOptimization(levelName.c_str(), optimizeIndexRange(sphereIndices, level.firstIndex,
+                                                                        level.indexCount, chain.vertexCount()));
+
+            const std::vector<Meshlet> levelMeshlets = buildMeshlets(sphereIndices, sphereVertices, 6,
+                                                                     level.firstIndex, level.indexCount);
+            levels.push_back({level.firstIndex, level.indexCount, level.error * sphereRadius,
+                              static_cast<uint32_t>(meshlets.size()), static_cast<uint32_t>(levelMeshlets.size())});
+            meshlets.insert(meshlets.end(), levelMeshlets.begin(), levelMeshlets.end());
+        }
+        optimizeVertexFetch(sphereVertices, 6, sphereIndices);
+        PackedMesh packed = packMesh(sphereVertices, sphereIndices);
+        packed.levels = std::move(levels);
+        packed.meshlets = std::move(meshlets);
+        return packed;
+    });
+
+    // Finest level for picking and collisions, which then match the sphere up close
+    const MeshLevel& sphereFinest = sphereMesh.levels()[sphereMesh.levelCount() - 1];
+    MeshBvh sphereBvh;
+    buildMeshBvh(sphereBvh, sphereMesh, sphereFinest.firstIndex, sphereFinest.indexCount);
 
     GLuint sphereVAO, sphereVBO, sphereEBO;
     glGenVertexArrays(1, &sphereVAO);
     glGenBuffers(1, &sphereVBO);
     glGenBuffers(1, &sphereEBO);
-
-    glBindVertexArray(sphereVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-    glBufferData(GL_ARRAY_BUFFER, sphereVertices.size() * sizeof(float), sphereVertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereIndices.size() * sizeof(unsigned int), sphereIndices.data(), GL_STATIC_DRAW);
-
-    // Position attribute for sphere
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Normal attribute for sphere
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glBindVertexArray(0);
+    uploadPackedMesh(sphereVAO, sphereVBO, sphereEBO, sphereMesh, GL_STATIC_DRAW);
 
     // Create Bezier plane with diamond hole
-    std::vector<float> planeVertices;
-    std::vector<unsigned int> planeIndices;
-    generateBezierPlane(planeVertices, planeIndices, 40, 2.0f);  // Higher resolution for smoother curves
+    const int planeResolution = 20;  // Trimmed exactly, so the hole stays sharp at low resolution
+    const float planeSize = 2.0f;
+    const MeshCacheKey planeKey = MeshCacheKey("bezier-plane").add(planeResolution).add(planeSize);
+    const CachedMesh planeMesh = meshCache.load(planeKey, [&] {
+        std::vector<float> planeVertices;
+        std::vector<unsigned int> planeIndices;
+        generateBezierPlane(planeVertices, planeIndices, planeResolution, planeSize);
+        printMeshOptimization("Plane", optimizeMesh(planeVertices, 6, planeIndices));
+        std::vector<Meshlet> planeMeshlets = buildMeshlets(planeIndices, planeVertices, 6);
+        optimizeVertexFetch(planeVertices, 6, planeIndices);
+
+        PackedMesh packed = packMesh(planeVertices, planeIndices);
+        packed.meshlets = std::move(planeMeshlets);
+        return packed;
+    });
+
+    MeshBvh planeBvh;
+    buildMeshBvh(planeBvh, planeMesh, 0, planeMesh.indexCount());
 
     GLuint planeVAO, planeVBO, planeEBO;
     glGenVertexArrays(1, &planeVAO);
     glGenBuffers(1, &planeVBO);
     glGenBuffers(1, &planeEBO);
-
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, planeVertices.size() * sizeof(float), planeVertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planeEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, planeIndices.size() * sizeof(unsigned int), planeIndices.data(), GL_STATIC_DRAW);
-
-    // Position attribute for plane
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Normal attribute for plane
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glBindVertexArray(0);
+    uploadPackedMesh(planeVAO, planeVBO, planeEBO, planeMesh, GL_STATIC_DRAW);
+
+    // View-dependent version of the same plane, filled in by the LOD worker
+    AdaptiveBezierSurface adaptivePlane(makeBezierPlaneSurface(2.0f), makeBezierPlaneTrim(2.0f));
+    std::vector<float> adaptiveVertices;
+    std::vector<unsigned int> adaptiveIndices;
+    std::vector<Meshlet> adaptiveMeshlets;
+    PackedMesh adaptivePlaneMesh;
+
+    GLuint adaptivePlaneVAO, adaptivePlaneVBO, adaptivePlaneEBO;
+    glGenVertexArrays(1, &adaptivePlaneVAO);
+    glGenBuffers(1, &adaptivePlaneVBO);
+    glGenBuffers(1, &adaptivePlaneEBO);
+
+    // Same plane as 4 x 4 patches that can be edited; Up/Down move the control point under the crosshair
+    MultiPatchSurface sculptPlane(makeBezierPlaneSurface(2.0f), makeBezierPlaneTrim(2.0f));
+    MeshBvh sculptBvh;
+    sculptBvh.build(decodeSculptPositions(sculptPlane),
+                    widenIndices(sculptPlane.packedMesh().indexData(), sculptPlane.packedMesh().indexType(), 0,
+                                 sculptPlane.packedMesh().indexCount()));
+
+    GLuint sculptPlaneVAO, sculptPlaneVBO, sculptPlaneEBO;
+    glGenVertexArrays(1, &sculptPlaneVAO);
+    glGenBuffers(1, &sculptPlaneVBO);
+    glGenBuffers(1, &sculptPlaneEBO);
+    uploadPackedMesh(sculptPlaneVAO, sculptPlaneVBO, sculptPlaneEBO, sculptPlane.packedMesh(), GL_DYNAMIC_DRAW);
+
+    // Unbounded terrain below the scene, streamed in chunks around the camera while enabled
+    StreamingTerrain terrain;
+    const glm::mat4 terrainModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -8.0f, 0.0f));
+    glm::vec3 terrainColor(0.45f, 0.4f, 0.3f);
 
     // Light properties and object colors
     glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
     glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
+    // Further lights, switched on one by one with K
+    const glm::vec3 extraLightPositions[MAX_SCENE_LIGHTS - 1] = {
+        {-4.0f, 2.0f, 3.0f}, {0.0f, 5.0f, -4.0f}, {6.0f, -3.0f, 3.0f}};
+    const glm::vec3 extraLightColors[MAX_SCENE_LIGHTS - 1] = {
+        {0.8f, 0.5f, 0.3f}, {0.3f, 0.4f, 0.8f}, {0.4f, 0.7f, 0.4f}};
     glm::vec3 sphereColor(0.5f, 0.2f, 0.7f);    // Purple-ish color for sphere
     glm::vec3 planeColor(0.2f, 0.6f, 0.5f);     // Teal-ish color for plane
+    glm::vec3 wireframeColor(0.9f, 0.9f, 0.9f); // Edge color of the wireframe overlay
+
+    // Visible meshlet ranges of the object being drawn, reused every draw
+    MeshletDrawList meshletDraws;
+
+    // Placement of both meshes, shared by drawing, picking and collisions
+    const glm::vec3 sphereCenter(0.0f, 0.0f, 0.0f);
+    const glm::mat4 sphereModel = glm::translate(glm::mat4(1.0f), sphereCenter);
+    const glm::mat4 planeModel = glm::translate(glm::mat4(1.0f), glm::vec3(4.0f, -1.0f, 0.0f));
 
     while (!glfwWindowShouldClose(window)) {
+        const glm::vec3 previousPosition = camera.position;
         processInput(window, camera);
 
+        // Moves that would take the camera into a mesh are undone
+        const MeshBvh& activePlaneBvh = planeMode == EPlaneMode::Sculpt ? sculptBvh : planeBvh;
+        if (meshTouchesSphere(sphereBvh, sphereModel, camera.position, cameraRadius)
+            || meshTouchesSphere(activePlaneBvh, planeModel, camera.position, cameraRadius))
+            camera.position = previousPosition;
+
+        // Click: ray through the crosshair (the cursor is captured at the window center)
+        if (pickRequested) {
+            pickRequested = false;
+            RayHit hit;
+            const char* picked = nullptr;
+            if (pickMesh(sphereBvh, sphereModel, camera.position, camera.front, hit))
+                picked = "sphere";
+            if (pickMesh(activePlaneBvh, planeModel, camera.position, camera.front, hit))
+                picked = "plane";
+            if (picked) {
+                const glm::vec3 point = camera.position + hit.distance * camera.front;
+                std::cout << "Picked " << picked << " triangle " << hit.triangle << " at (" << point.x << ", "
+                          << point.y << ", " << point.z << "), distance " << hit.distance << std::endl;
+            } else {
+                std::cout << "Picked nothing" << std::endl;
+            }
+        }
+
+        if (shaderWatcher.changed() && readShaderSources(LAB4_SHADER_DIR, sceneSources))
+            sceneVariants.reload(sceneSources);
+        sceneVariants.update();
+
+        const uint32_t sphereVariant = sceneVariantKey(sphereWireframe, fogEnabled, lightCount);
+        const uint32_t planeVariant = sceneVariantKey(planeWireframe, fogEnabled, lightCount);
+        ShaderProgram& sphereShader = sceneVariants.get(sphereVariant);
+        ShaderProgram& planeShader = sceneVariants.get(planeVariant);
+        prefetchSceneNeighbours(sceneVariants, sphereVariant);
+        prefetchSceneNeighbours(sceneVariants, planeVariant);
+
+        // Sizes in pixels come from the framebuffer, which is larger than the window by the
+        // content scale on HiDPI displays
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        framebufferWidth = std::max(framebufferWidth, 1);
+        framebufferHeight = std::max(framebufferHeight, 1);
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
+        const float aspectRatio = (float)framebufferWidth / (float)framebufferHeight;
+
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);  // Dark background
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(shaderProgram);
-
-        // Set lighting uniforms
-        glUniform3fv(glGetUniformLocation(shaderProgram, "lightPos"), 1, glm::value_ptr(lightPos));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, glm::value_ptr(camera.position));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "lightColor"), 1, glm::value_ptr(lightColor));
+        uniformRing.beginFrame();
 
         glm::mat4 view = getViewMatrix(camera);
         glm::mat4 projection;
         if (usePerspective) {
-            projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+            projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 100.0f);
         }
         else {
-            float aspectRatio = (float)SCR_WIDTH / (float)SCR_HEIGHT;
             float halfSize = orthogonalSize / 2.0f;
             projection = glm::ortho(-halfSize * aspectRatio, halfSize * aspectRatio, -halfSize, halfSize, 0.1f, 100.0f);
         }
 
-        GLuint viewLoc = glGetUniformLocation(shaderProgram, "view");
-        GLuint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-        GLuint modelLoc = glGetUniformLocation(shaderProgram, "model");
-
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
         // Move the light position over time for dynamic lighting effect
         float timeValue = glfwGetTime();
         // lightPos.x = 2.4f + sin(timeValue) * 2.0f;
@@ -632,24 +602,108 @@ int main() {
         lightPos.y = 3.0f;
         lightPos.z = -0.5f;
 
+        // Camera, light and wireframe style for every draw of the frame
+        FrameUniforms frame;
+        frame.view = view;
+        frame.projection = projection;
+        frame.viewProjection = projection * view;
+        frame.viewPos = glm::vec4(camera.position, 1.0f);
+        frame.lightPos[0] = glm::vec4(lightPos, 1.0f);
+        frame.lightColor[0] = glm::vec4(lightColor, 1.0f);
+        for (int i = 1; i < MAX_SCENE_LIGHTS; i++) {
+            frame.lightPos[i] = glm::vec4(extraLightPositions[i - 1], 1.0f);
+            frame.lightColor[i] = glm::vec4(extraLightColors[i - 1], 1.0f);
+        }
+        frame.wireframeStyle = glm::vec4(wireframeColor, 1.5f);
+        frame.fogStyle = glm::vec4(0.1f, 0.1f, 0.1f, 0.08f);  // Fades into the background colour
+        frame.viewportSize = glm::vec2((float)framebufferWidth, (float)framebufferHeight);
+        frame.padding = glm::vec2(0.0f);
+        uniformRing.bind(FRAME_BLOCK_BINDING, frame);
+
+        // Pixels per unit at distance 1 in perspective projection, everywhere in orthographic
+        const float pixelsPerUnit = usePerspective ? framebufferHeight / (2.0f * tanf(glm::radians(45.0f) / 2.0f))
+                                                   : framebufferHeight / orthogonalSize;
 
         // Draw sphere
-        glm::mat4 sphereModel = glm::mat4(1.0f);
-        sphereModel = glm::translate(sphereModel, glm::vec3(0.0f, 0.0f, 0.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(sphereModel));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "objectColor"), 1, glm::value_ptr(sphereColor));
+        sphereShader.use();
+        uniformRing.bind(OBJECT_BLOCK_BINDING, makeObjectUniforms(sphereModel, sphereColor));
+
+        setPackedMeshUniforms(sphereShader, sphereMesh);
 
         glBindVertexArray(sphereVAO);
-        glDrawElements(GL_LINE_STRIP, sphereIndices.size(), GL_UNSIGNED_INT, 0);
+        const float sphereDistance = usePerspective ? std::max(glm::length(camera.position - sphereCenter), 0.1f) : 1.0f;
+        const int sphereLevel = selectSphereLevel(sphereMesh.levels(), sphereMesh.levelCount(),
+                                                  sphereRadius * pixelsPerUnit / sphereDistance);
+        const MeshLevel& sphereRange = sphereMesh.levels()[sphereLevel];
+
+        // Only the meshlets that face the camera and touch the frustum are drawn
+        const MeshletView sphereView = makeMeshletView(sphereModel, view, projection, usePerspective, true);
+        cullMeshlets(sphereMesh.meshlets() + sphereRange.firstMeshlet, sphereRange.meshletCount, sphereView,
+                     sphereMesh.indexSize(), meshletDraws);
+        drawMeshlets(meshletDraws, sphereMesh.indexType());
 
         // Draw Bezier plane with hole
-        glm::mat4 planeModel = glm::mat4(1.0f);
-        planeModel = glm::translate(planeModel, glm::vec3(4.0f, -1.0f, 0.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(planeModel));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "objectColor"), 1, glm::value_ptr(planeColor));
+        planeShader.use();
+        uniformRing.bind(OBJECT_BLOCK_BINDING, makeObjectUniforms(planeModel, planeColor));
+
+        // Pick tessellation levels for the current camera and upload a rebuilt mesh once it is ready
+        LodView lodView;
+        lodView.eye = glm::vec3(glm::inverse(planeModel) * glm::vec4(camera.position, 1.0f));
+        lodView.perspective = usePerspective;
+        lodView.pixelsPerUnit = pixelsPerUnit;
+        if (planeMode == EPlaneMode::Adaptive)
+            adaptivePlane.update(lodView);
+
+        if (adaptivePlane.takeMesh(adaptiveVertices, adaptiveIndices, adaptiveMeshlets)) {
+            adaptivePlaneMesh = packMesh(adaptiveVertices, adaptiveIndices);
+            adaptivePlaneMesh.meshlets = std::move(adaptiveMeshlets);
+            uploadPackedMesh(adaptivePlaneVAO, adaptivePlaneVBO, adaptivePlaneEBO, adaptivePlaneMesh, GL_DYNAMIC_DRAW);
+        }
+
+        // Edits only re-tessellate and re-upload the patches they touch
+        if (planeMode == EPlaneMode::Sculpt && sculptDirection != 0.0f) {
+            const glm::mat4 inverseModel = glm::inverse(planeModel);
+            int i, j;
+            if (sculptPlane.nearestControlPoint(glm::vec3(inverseModel * glm::vec4(camera.position, 1.0f)),
+                                                glm::vec3(inverseModel * glm::vec4(camera.front, 0.0f)), i, j))
+                sculptPlane.moveControlPoint(i, j, glm::vec3(0.0f, 0.02f * sculptDirection, 0.0f));
+        }
+        sculptPlane.update();
+        if (sculptPlane.uploadFinishedPatches(sculptPlaneVBO))
+            sculptBvh.refit(decodeSculptPositions(sculptPlane));
+
+        // The plane is open and seen from both sides, so its meshlets are only frustum culled
+        const MeshletView planeView = makeMeshletView(planeModel, view, projection, usePerspective, false);
+
+        // The fixed grid also stands in until the first adaptive mesh has arrived
+        if (planeMode == EPlaneMode::Hardware) {
+            patchRenderer.draw();
+        } else if (planeMode == EPlaneMode::Sculpt) {
+            setPackedMeshUniforms(planeShader, sculptPlane.packedMesh());
+            glBindVertexArray(sculptPlaneVAO);
+            glDrawElements(GL_TRIANGLES, sculptPlane.packedMesh().indexCount(), sculptPlane.packedMesh().indexType(), 0);
+        } else if (planeMode == EPlaneMode::Adaptive && adaptivePlaneMesh.indexCount() > 0) {
+            cullMeshlets(adaptivePlaneMesh.meshlets.data(), static_cast<int>(adaptivePlaneMesh.meshlets.size()),
+                         planeView, adaptivePlaneMesh.indexSize(), meshletDraws);
+            setPackedMeshUniforms(planeShader, adaptivePlaneMesh);
+            glBindVertexArray(adaptivePlaneVAO);
+            drawMeshlets(meshletDraws, adaptivePlaneMesh.indexType());
+        } else {
+            cullMeshlets(planeMesh.meshlets(), planeMesh.meshletCount(), planeView, planeMesh.indexSize(), meshletDraws);
+            setPackedMeshUniforms(planeShader, planeMesh);
+            glBindVertexArray(planeVAO);
+            drawMeshlets(meshletDraws, planeMesh.indexType());
+        }
+
+        if (terrainEnabled) {
+            terrain.update(glm::vec3(glm::inverse(terrainModel) * glm::vec4(camera.position, 1.0f)),
+                           camera.position - previousPosition);
+            planeShader.use();
+            uniformRing.bind(OBJECT_BLOCK_BINDING, makeObjectUniforms(terrainModel, terrainColor));
+            terrain.draw(planeShader, makeMeshletView(terrainModel, view, projection, usePerspective, false), meshletDraws);
+        }
 
-        glBindVertexArray(planeVAO);
-        glDrawElements(GL_TRIANGLES, planeIndices.size(), GL_UNSIGNED_INT, 0);
+        uniformRing.endFrame();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -664,7 +718,25 @@ int main() {
     glDeleteBuffers(1, &planeVBO);
     glDeleteBuffers(1, &planeEBO);
 
-    glDeleteProgram(shaderProgram);
+    glDeleteVertexArrays(1, &adaptivePlaneVAO);
+    glDeleteBuffers(1, &adaptivePlaneVBO);
+    glDeleteBuffers(1, &adaptivePlaneEBO);
+
+    glDeleteVertexArrays(1, &sculptPlaneVAO);
+    glDeleteBuffers(1, &sculptPlaneVBO);
+    glDeleteBuffers(1, &sculptPlaneEBO);
+
+    terrain.destroy();
+    uniformRing.destroy();
+
+    if (hardwareTessellationAvailable)
+        patchRenderer.destroy();
+
+    shaderCompiler.destroy();
+    shaderWatcher.destroy();
+    if (compileContext)
+        glfwDestroyWindow(compileContext);
+    sceneVariants.destroy();
 
     glfwTerminate();
     return 0;
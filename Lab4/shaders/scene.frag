@@ -0,0 +1,68 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+#ifdef WIREFRAME
+noperspective in vec3 EdgeDistance;
+#endif
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos[MAX_LIGHTS];
+    vec4 lightColor[MAX_LIGHTS];
+    vec4 wireframeStyle;  // rgb: colour, a: line width in pixels
+    vec4 fogStyle;        // rgb: colour, a: density
+    vec2 viewportSize;
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    mat3 normalMatrix;
+    vec3 objectColor;
+};
+
+void main() {
+    vec3 norm = normalize(Normal);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
+
+    // LIGHT_COUNT is a constant, so the loop is unrolled
+    vec3 lighting = vec3(0.0);
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        // Ambient lighting
+        float ambientStrength = 0.1;
+        vec3 ambient = ambientStrength * lightColor[i].rgb;
+
+        // Diffuse lighting
+        vec3 lightDir = normalize(lightPos[i].xyz - FragPos);
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 diffuse = diff * lightColor[i].rgb;
+
+        // Specular lighting
+        float specularStrength = 0.5;
+        vec3 reflectDir = reflect(-lightDir, norm);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+        vec3 specular = specularStrength * spec * lightColor[i].rgb;
+
+        lighting += ambient + diffuse + specular;
+    }
+    vec3 result = lighting * objectColor;
+
+#ifdef WIREFRAME
+    // Triangle edges over the shading, antialiased across one pixel
+    float edge = min(EdgeDistance.x, min(EdgeDistance.y, EdgeDistance.z));
+    float width = wireframeStyle.a;
+    float coverage = 1.0 - smoothstep(0.5 * width - 0.5, 0.5 * width + 0.5, edge);
+    result = mix(result, wireframeStyle.rgb, coverage);
+#endif
+
+#ifdef FOG
+    // Exponential fog over the distance to the camera
+    float fogFactor = exp(-fogStyle.a * length(viewPos.xyz - FragPos));
+    result = mix(fogStyle.rgb, result, fogFactor);
+#endif
+    FragColor = vec4(result, 1.0);
+}
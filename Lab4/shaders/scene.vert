@@ -0,0 +1,56 @@
+#version 330 core
+// The variant's defines are inserted after the #version line (sceneVariantSources in
+// main.cpp): MAX_LIGHTS, LIGHT_COUNT, and WIREFRAME and FOG when those features are on
+layout (location = 0) in vec3 aPos;     // unorm16, relative to the mesh bounds (PackedVertex)
+layout (location = 1) in vec2 aNormal;  // Octahedral snorm16
+
+#ifndef WIREFRAME
+// Without the wireframe overlay there is no geometry shader, so the outputs feed the
+// fragment shader directly
+#define VertexPos FragPos
+#define VertexNormal Normal
+#endif
+
+out vec3 VertexPos;
+out vec3 VertexNormal;
+
+// FrameUniforms and ObjectUniforms (UniformRing.h)
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos[MAX_LIGHTS];
+    vec4 lightColor[MAX_LIGHTS];
+    vec4 wireframeStyle;
+    vec4 fogStyle;
+    vec2 viewportSize;
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    mat3 normalMatrix;  // Inverse transpose of the model matrix, computed on the CPU
+    vec3 objectColor;
+};
+
+uniform vec3 positionMin;
+uniform vec3 positionScale;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
+
+void main() {
+    vec3 position = positionMin + aPos * positionScale;
+    vec3 normal = decodeOctahedral(aNormal);
+
+    vec4 worldPos = model * vec4(position, 1.0);
+    VertexPos = worldPos.xyz;
+    VertexNormal = normalMatrix * normal;
+
+    gl_Position = viewProjection * worldPos;
+}
@@ -0,0 +1,326 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+// Post-transform vertex cache efficiency of an indexed triangle list, measured with a FIFO
+// cache: ACMR = transformed vertices per triangle (0.5 is the limit for a regular grid, 3
+// means no reuse), ATVR = transformed vertices per referenced vertex (1 is ideal).
+struct VertexCacheStats {
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+inline VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+                                           unsigned int cacheSize = 16) {
+    VertexCacheStats stats;
+    if (indices.size() < 3)
+        return stats;
+
+    // A vertex is in the FIFO while fewer than cacheSize misses have happened since it entered
+    std::vector<unsigned int> entered(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    unsigned int misses = 0;
+    size_t referencedCount = 0;
+
+    for (unsigned int index : indices) {
+        if (entered[index] == 0 || misses - entered[index] >= cacheSize)
+            entered[index] = ++misses;
+        if (!referenced[index]) {
+            referenced[index] = true;
+            referencedCount++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / (indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / referencedCount;
+    return stats;
+}
+
+// Reorders triangles for the post-transform vertex cache with Tipsify (Sander, Nehab and
+// Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007): fans
+// are emitted around one vertex at a time, and the next fanning vertex is the neighbour
+// that is still in the cache and has the fewest triangles left.
+//
+// When the walk hits a dead end and has to jump elsewhere in the mesh, the position in the
+// output (in triangles) is appended to `clusters`, if given: these are the hard boundaries
+// that optimizeOverdraw() may move around freely.
+inline void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16,
+                                std::vector<unsigned int>* clusters = nullptr) {
+    const size_t triangleCount = indices.size() / 3;
+    if (clusters)
+        clusters->assign(1, 0);
+    if (triangleCount == 0)
+        return;
+
+    // Vertex -> triangles adjacency in compressed rows
+    std::vector<unsigned int> live(vertexCount, 0);
+    for (unsigned int index : indices)
+        live[index]++;
+
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    std::partial_sum(live.begin(), live.end(), adjacencyOffset.begin() + 1);
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t k = 0; k < indices.size(); k++)
+            adjacency[fill[indices[k]]++] = static_cast<unsigned int>(k / 3);
+    }
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnds;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    unsigned int time = cacheSize + 1;
+    size_t cursor = 0;
+
+    // Next vertex with triangles left, from the dead-end stack or else in input order
+    auto skipDeadEnd = [&]() -> long long {
+        while (!deadEnds.empty()) {
+            const unsigned int vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[vertex] > 0)
+                return vertex;
+        }
+        for (; cursor < vertexCount; cursor++) {
+            if (live[cursor] > 0)
+                return static_cast<long long>(cursor);
+        }
+        return -1;
+    };
+
+    long long fanning = skipDeadEnd();
+    while (fanning >= 0) {
+        candidates.clear();
+        for (unsigned int a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; a++) {
+            const unsigned int triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+
+            for (int corner = 0; corner < 3; corner++) {
+                const unsigned int vertex = indices[triangle * 3 + corner];
+                result.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                live[vertex]--;
+                if (time - cacheTime[vertex] > cacheSize)
+                    cacheTime[vertex] = time++;
+            }
+        }
+
+        // Candidate that stays in the cache for all of its remaining triangles, oldest first
+        long long best = -1;
+        long long bestPriority = -1;
+        for (unsigned int vertex : candidates) {
+            if (live[vertex] == 0)
+                continue;
+            long long priority = 0;
+            if (time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize)
+                priority = time - cacheTime[vertex];
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = vertex;
+            }
+        }
+
+        if (best < 0) {
+            best = skipDeadEnd();
+            if (best >= 0 && clusters && result.size() / 3 < triangleCount)
+                clusters->push_back(static_cast<unsigned int>(result.size() / 3));
+        }
+        fanning = best;
+    }
+
+    indices = std::move(result);
+}
+
+// Reorders the clusters of a cache-optimized triangle list so that triangles likely to be
+// in front are drawn first (the view-independent overdraw ordering of Tipsify): each hard
+// cluster from optimizeVertexCache() is split further wherever its ACMR so far is within
+// `threshold` of the cluster's own, and clusters are sorted by how far their centroid lies
+// outside the mesh along their average normal. Positions are read from the first three
+// floats of each vertex, `stride` floats apart.
+inline void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices, int stride,
+                             const std::vector<unsigned int>& clusters, unsigned int cacheSize = 16,
+                             float threshold = 1.05f) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || clusters.empty())
+        return;
+
+    auto position = [&](unsigned int vertex) {
+        const float* p = &vertices[static_cast<size_t>(vertex) * stride];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // Soft boundaries inside every hard cluster
+    std::vector<unsigned int> boundaries;
+    {
+        std::vector<unsigned int> entered(vertices.size() / stride, 0);
+        unsigned int misses = 0;
+        auto countMisses = [&](size_t triangle) {
+            unsigned int count = 0;
+            for (int corner = 0; corner < 3; corner++) {
+                unsigned int& vertexEntered = entered[indices[triangle * 3 + corner]];
+                if (vertexEntered == 0 || misses - vertexEntered >= cacheSize) {
+                    vertexEntered = ++misses;
+                    count++;
+                }
+            }
+            return count;
+        };
+        // Forget the cache contents by moving every entry out of the FIFO window
+        auto flush = [&] { misses += cacheSize; };
+
+        for (size_t c = 0; c < clusters.size(); c++) {
+            const size_t begin = clusters[c];
+            const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+            flush();
+            unsigned int clusterMisses = 0;
+            for (size_t t = begin; t < end; t++)
+                clusterMisses += countMisses(t);
+            const float clusterThreshold = threshold * clusterMisses / (end - begin);
+
+            flush();
+            size_t start = begin;
+            unsigned int runningMisses = 0;
+            boundaries.push_back(static_cast<unsigned int>(begin));
+            for (size_t t = begin; t + 1 < end; t++) {
+                runningMisses += countMisses(t);
+                if (static_cast<float>(runningMisses) / (t - start + 1) <= clusterThreshold) {
+                    boundaries.push_back(static_cast<unsigned int>(t + 1));
+                    start = t + 1;
+                    runningMisses = 0;
+                    flush();
+                }
+            }
+        }
+    }
+
+    // Area-weighted centroid and normal of every cluster, and of the whole mesh
+    const size_t clusterCount = boundaries.size();
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    std::vector<float> areas(clusterCount, 0.0f);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; c++) {
+        const size_t end = c + 1 < clusterCount ? boundaries[c + 1] : triangleCount;
+        for (size_t t = boundaries[c]; t < end; t++) {
+            const glm::vec3 p0 = position(indices[t * 3]);
+            const glm::vec3 p1 = position(indices[t * 3 + 1]);
+            const glm::vec3 p2 = position(indices[t * 3 + 2]);
+            const glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            const float area = glm::length(cross);
+            const glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+
+            centroids[c] += center * area;
+            normals[c] += cross;
+            areas[c] += area;
+            meshCentroid += center * area;
+            meshArea += area;
+        }
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    std::vector<float> sortKeys(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; c++) {
+        const float normalLength = glm::length(normals[c]);
+        if (areas[c] > 0.0f && normalLength > 0.0f)
+            sortKeys[c] = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / normalLength);
+    }
+
+    std::vector<unsigned int> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        return sortKeys[a] > sortKeys[b];
+    });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (unsigned int c : order) {
+        const size_t end = c + 1 < clusterCount ? boundaries[c + 1] : triangleCount;
+        result.insert(result.end(), indices.begin() + boundaries[c] * 3, indices.begin() + end * 3);
+    }
+    indices = std::move(result);
+}
+
+// Reorders the vertex buffer into the order the indices first use each vertex and rewrites
+// the indices to match, so vertex fetches walk memory forward. Vertices no index refers to
+// are dropped. Returns the new vertex count.
+inline size_t optimizeVertexFetch(std::vector<float>& vertices, int stride, std::vector<unsigned int>& indices) {
+    const size_t vertexCount = vertices.size() / stride;
+    constexpr unsigned int UNUSED = ~0u;
+    std::vector<unsigned int> remap(vertexCount, UNUSED);
+
+    std::vector<float> result;
+    result.reserve(vertices.size());
+    unsigned int next = 0;
+    for (unsigned int& index : indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = next++;
+            result.insert(result.end(), vertices.begin() + static_cast<size_t>(index) * stride,
+                          vertices.begin() + static_cast<size_t>(index + 1) * stride);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(result);
+    return next;
+}
+
+struct MeshOptimizationReport {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// Full pass for an indexed triangle list with interleaved float vertices (position first):
+// vertex cache order, overdraw cluster order, then vertex fetch order
+inline MeshOptimizationReport optimizeMesh(std::vector<float>& vertices, int stride, std::vector<unsigned int>& indices,
+                                           unsigned int cacheSize = 16) {
+    MeshOptimizationReport report;
+    report.before = analyzeVertexCache(indices, vertices.size() / stride, cacheSize);
+
+    std::vector<unsigned int> clusters;
+    optimizeVertexCache(indices, vertices.size() / stride, cacheSize, &clusters);
+    optimizeOverdraw(indices, vertices, stride, clusters, cacheSize);
+    optimizeVertexFetch(vertices, stride, indices);
+
+    report.after = analyzeVertexCache(indices, vertices.size() / stride, cacheSize);
+    return report;
+}
+
+// Vertex cache order for the triangles in [firstIndex, firstIndex + indexCount) alone, e.g.
+// one level of a LOD chain sharing its vertex buffer with the others; the rest of the
+// indices and the vertices are left as they are
+inline MeshOptimizationReport optimizeIndexRange(std::vector<unsigned int>& indices, size_t firstIndex,
+                                                 size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16) {
+    std::vector<unsigned int> range(indices.begin() + firstIndex, indices.begin() + firstIndex + indexCount);
+    MeshOptimizationReport report;
+    report.before = analyzeVertexCache(range, vertexCount, cacheSize);
+    optimizeVertexCache(range, vertexCount, cacheSize);
+    report.after = analyzeVertexCache(range, vertexCount, cacheSize);
+    std::copy(range.begin(), range.end(), indices.begin() + firstIndex);
+    return report;
+}
+
+inline void printMeshOptimization(const char* name, const MeshOptimizationReport& report) {
+    std::cout << std::fixed << std::setprecision(3)
+              << name << " mesh: ACMR " << report.before.acmr << " -> " << report.after.acmr
+              << ", ATVR " << report.before.atvr << " -> " << report.after.atvr << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+#endif //MESHOPTIMIZER_H
@@ -0,0 +1,55 @@
+#ifndef SPHEREDRAW_H
+#define SPHEREDRAW_H
+
+#include <GL/gl.h>
+#include <algorithm>
+#include <cmath>
+#include "SphereGenerators.h"
+
+// Triangles gluSphere draws for slices x stacks: a fan at each pole, quads in between
+inline unsigned int gluSphereTriangles(int slices, int stacks) {
+    return 2u * static_cast<unsigned int>(slices) * static_cast<unsigned int>(stacks - 1);
+}
+
+// Draws a sphere of the given radius from a level chain with client arrays, in place of
+// gluSphere(quadric, radius, slices, stacks). The level is the coarsest within one pixel of
+// the true sphere for its size on screen, but never one with more triangles than that
+// gluSphere call drew; the coarsest level is drawn if even it has more.
+inline void drawLodSphere(const SphereLodChain& lods, float radius, int slices, int stacks) {
+    GLfloat modelview[16], projection[16];
+    GLint viewport[4];
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // Radius in pixels; in perspective divided by the distance from the eye to the center
+    const float scale = std::sqrt(modelview[0] * modelview[0] + modelview[1] * modelview[1] + modelview[2] * modelview[2]);
+    float radiusPixels = radius * scale * projection[5] * viewport[3] / 2.0f;
+    if (projection[15] == 0.0f) {
+        const float distance = std::sqrt(modelview[12] * modelview[12] + modelview[13] * modelview[13] + modelview[14] * modelview[14]);
+        radiusPixels /= std::max(distance, 1e-3f);
+    }
+    int levelIndex = lods.selectLevel(radiusPixels);
+    const unsigned int budget = gluSphereTriangles(slices, stacks);
+    while (levelIndex > 0 && lods.levels[levelIndex].indexCount / 3 > budget)
+        levelIndex--;
+    const SphereLodChain::Level& level = lods.levels[levelIndex];
+
+    // The unit sphere's normal is its position; GL_NORMALIZE restores its length after glScalef
+    const GLsizei stride = SphereLodChain::STRIDE * sizeof(float);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, lods.vertices.data());
+    glNormalPointer(GL_FLOAT, stride, lods.vertices.data());
+    glTexCoordPointer(2, GL_FLOAT, stride, lods.vertices.data() + 3);
+
+    glPushMatrix();
+    glScalef(radius, radius, radius);
+    glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, lods.indices.data() + level.firstIndex);
+    glPopMatrix();
+    glPopClientAttrib();
+}
+
+#endif //SPHEREDRAW_H
@@ -6,10 +6,15 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <chrono>
+#include <string>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "ELightSources.h"
 #include "stb_image.h"
+#include "SphereDraw.h"
+#include "SphereGenerators.h"
+#include "MeshOptimizer.h"
+#include "GLStateCache.h"
 
 // Light IDs (OpenGL has GL_LIGHT0 to GL_LIGHT7)
 #define AMBIENT_LIGHT    GL_LIGHT0
@@ -27,6 +32,13 @@ GLfloat viewAngle = 50.0f;             // Кут огляду
 GLuint starTexture;
 GLuint moonTexture;
 
+// Сфера з рівнями деталізації, спільна для всіх сферичних об'єктів
+SphereLodChain sphereLods;
+
+// Кеш стану OpenGL: відкидає виклики glEnable/glDisable/glBindTexture, що нічого не змінюють
+GLStateCache glState;
+GLStateCounters lastFrameStateCalls;  // Лічильники попереднього кадру для виводу на екран
+
 // Параметри для туману
 GLfloat fogColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
 bool enableFog = false;
@@ -201,6 +213,17 @@ void init(void) {
     moonTexture = loadTexture("..\\Textures\\moon-texture.jpg");
     starTexture = loadTexture("..\\Textures\\star_texture.jpg");
 
+    // Рівні деталізації сфери: куб із 2^L x 2^L клітинками на грань, спроектований на сферу.
+    // Рівень 4 - найдрібніший, що вкладається в кількість трикутників колишніх gluSphere
+    sphereLods = generateCubeSphere(4);
+    // Кожен рівень окремо впорядковується для кешу вершин; вершини спільні для всіх рівнів
+    for (size_t l = 0; l < sphereLods.levels.size(); l++) {
+        const SphereLodChain::Level& level = sphereLods.levels[l];
+        const std::string levelName = "Sphere level " + std::to_string(l);
+        printMeshOptimization(levelName.c_str(), optimizeIndexRange(sphereLods.indices, level.firstIndex,
+                                                                    level.indexCount, sphereLods.vertexCount()));
+    }
+
     // Налаштування туману для космічного простору
     glFogi(GL_FOG_MODE, GL_EXP);
     glFogfv(GL_FOG_COLOR, fogColor);
@@ -213,6 +236,8 @@ void init(void) {
 
 // Функція малювання зорі
 void drawStar() {
+    // Текст кадру вимикає освітлення; вмикаємо до glPushAttrib, щоб glPopAttrib його не скасував
+    glState.enable(GL_LIGHTING);
 
     glPushAttrib(GL_LIGHTING_BIT);
 
@@ -223,31 +248,27 @@ void drawStar() {
     }
 
     // Накладаємо текстуру зорі
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, starTexture);
+    glState.enable(GL_TEXTURE_2D);
+    glState.bindTexture(GL_TEXTURE_2D, starTexture);
 
     glPushMatrix();
 
     glRotatef(90.0f, 1.0f, 0.0f, 0.0f);
 
     // Малюємо сферу для зорі
-    GLUquadricObj *quadric = gluNewQuadric();
-    gluQuadricTexture(quadric, GL_TRUE);
-    gluSphere(quadric, 2.0f, 50, 50);
-    gluDeleteQuadric(quadric);
+    drawLodSphere(sphereLods, 2.0f, 50, 50);
 
     glPopMatrix();
 
-    glDisable(GL_TEXTURE_2D);
-
     glPopAttrib();
 }
 
 // Функція малювання планети з місячною поверхнею
 void drawPlanet() {
     // Накладаємо текстуру місячної поверхні
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, moonTexture);
+    glState.enable(GL_LIGHTING);
+    glState.enable(GL_TEXTURE_2D);
+    glState.bindTexture(GL_TEXTURE_2D, moonTexture);
 
     // Місячно-сірий колір для планети
     glColor3f(1.0f, 1.0f, 1.0f);
@@ -258,20 +279,16 @@ void drawPlanet() {
 
 
     // Малюємо сферу для планети
-    GLUquadricObj *quadric = gluNewQuadric();
-    gluQuadricTexture(quadric, GL_TRUE);
-    gluSphere(quadric, 0.8f, 30, 30);
-    gluDeleteQuadric(quadric);
+    drawLodSphere(sphereLods, 0.8f, 30, 30);
 
     glPopMatrix();
-
-    glDisable(GL_TEXTURE_2D);
 }
 
 // Функція для відображення тексту на екрані
 void renderText(float x, float y, const char* text, void* font = GLUT_BITMAP_HELVETICA_12) {
-    glDisable(GL_LIGHTING);
-    glDisable(GL_TEXTURE_2D);
+    // Стан не відновлюємо: наступний рядок тексту вимкнув би його знову, а об'єкти вмикають його самі
+    glState.disable(GL_LIGHTING);
+    glState.disable(GL_TEXTURE_2D);
     glColor3f(1.0f, 1.0f, 1.0f);
 
     // Встановлюємо позицію тексту
@@ -295,9 +312,6 @@ void renderText(float x, float y, const char* text, void* font = GLUT_BITMAP_HEL
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
-
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_LIGHTING);
 }
 
 void lightUpdate() {
@@ -444,8 +458,15 @@ void display(void) {
     sprintf(buffer, "FreeLook Mode: %s  [F] to toggle", freeLookMode ? "ON" : "OFF");
     renderText(10, glutGet(GLUT_WINDOW_HEIGHT) - 60, buffer);
 
+    sprintf(buffer, "GL state calls: %llu issued, %llu elided",
+            (unsigned long long)lastFrameStateCalls.issued, (unsigned long long)lastFrameStateCalls.elided);
+    renderText(10, glutGet(GLUT_WINDOW_HEIGHT) - 80, buffer);
+
     // Відображення результату на екрані
     glutSwapBuffers();
+
+    lastFrameStateCalls = glState.counters();
+    glState.resetCounters();
 }
 
 // Функція для зміни розміру вікна
@@ -689,35 +710,35 @@ void keyboardUp(unsigned char key, int x, int y) {
             }
             break;
         case '1': // Фонове освітлення
-            glEnable(AMBIENT_LIGHT);
-            glDisable(POINT_LIGHT);
-            glDisable(DIRECTIONAL_LIGHT);
-            glDisable(SPOTLIGHT);
+            glState.enable(AMBIENT_LIGHT);
+            glState.disable(POINT_LIGHT);
+            glState.disable(DIRECTIONAL_LIGHT);
+            glState.disable(SPOTLIGHT);
             break;
         case '2':
-            glDisable(AMBIENT_LIGHT);
-            glEnable(POINT_LIGHT);
-            glDisable(DIRECTIONAL_LIGHT);
-            glDisable(SPOTLIGHT);
+            glState.disable(AMBIENT_LIGHT);
+            glState.enable(POINT_LIGHT);
+            glState.disable(DIRECTIONAL_LIGHT);
+            glState.disable(SPOTLIGHT);
             break;
         case '3':
-            glDisable(AMBIENT_LIGHT);
-            glDisable(POINT_LIGHT);
-            glEnable(DIRECTIONAL_LIGHT);
-            glDisable(SPOTLIGHT);
+            glState.disable(AMBIENT_LIGHT);
+            glState.disable(POINT_LIGHT);
+            glState.enable(DIRECTIONAL_LIGHT);
+            glState.disable(SPOTLIGHT);
             break;
         case '4':
-            glDisable(AMBIENT_LIGHT);
-            glDisable(POINT_LIGHT);
-            glDisable(DIRECTIONAL_LIGHT);
-            glEnable(SPOTLIGHT);
+            glState.disable(AMBIENT_LIGHT);
+            glState.disable(POINT_LIGHT);
+            glState.disable(DIRECTIONAL_LIGHT);
+            glState.enable(SPOTLIGHT);
             break;
         case '5':
             enableFog = !enableFog;
             if (enableFog)
-                glEnable(GL_FOG);
+                glState.enable(GL_FOG);
             else
-                glDisable(GL_FOG);
+                glState.disable(GL_FOG);
             break;
     }
     glutPostRedisplay();
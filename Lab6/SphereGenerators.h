@@ -0,0 +1,304 @@
+#ifndef SPHEREGENERATORS_H
+#define SPHEREGENERATORS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Unit sphere at several levels of detail. All levels index one shared vertex buffer, so
+// switching level only changes which range of the index buffer is drawn.
+struct SphereLodChain {
+    struct Level {
+        unsigned int firstIndex;
+        unsigned int indexCount;
+        float error;  // Largest distance between a triangle and the unit sphere
+    };
+
+    // x, y, z, u, v per vertex; on the unit sphere the normal equals the position
+    static constexpr int STRIDE = 5;
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;  // All levels back to back, coarsest first
+    std::vector<Level> levels;
+
+    size_t vertexCount() const {
+        return vertices.size() / STRIDE;
+    }
+
+    int selectLevel(float radiusPixels, float tolerancePixels = 1.0f) const;
+
+    // Interleaved position + normal (6 floats per vertex) for a sphere of the given radius
+    std::vector<float> positionNormalVertices(float radius) const {
+        std::vector<float> result(vertexCount() * 6);
+        for (size_t v = 0; v < vertexCount(); v++) {
+            for (int axis = 0; axis < 3; axis++) {
+                result[v * 6 + axis] = vertices[v * STRIDE + axis] * radius;
+                result[v * 6 + 3 + axis] = vertices[v * STRIDE + axis];
+            }
+        }
+        return result;
+    }
+};
+
+// Coarsest level whose error stays within tolerancePixels on a sphere that is radiusPixels
+// large on screen. Works for any level type with an error field, levels coarsest first.
+template <typename Level>
+int selectSphereLevel(const Level* levels, int levelCount, float radiusPixels, float tolerancePixels = 1.0f) {
+    for (int level = 0; level < levelCount; level++) {
+        if (levels[level].error * radiusPixels <= tolerancePixels)
+            return level;
+    }
+    return levelCount - 1;
+}
+
+inline int SphereLodChain::selectLevel(float radiusPixels, float tolerancePixels) const {
+    return selectSphereLevel(levels.data(), static_cast<int>(levels.size()), radiusPixels, tolerancePixels);
+}
+
+inline void appendSphereVertex(SphereLodChain& chain, double x, double y, double z) {
+    const double length = std::sqrt(x * x + y * y + z * z);
+    chain.vertices.insert(chain.vertices.end(), {
+        static_cast<float>(x / length), static_cast<float>(y / length), static_cast<float>(z / length), 0.0f, 0.0f
+    });
+}
+
+// Records indices[firstIndex..] as the next level. The error of a flat triangle inscribed in
+// the unit sphere is 1 minus the distance from the center to its plane.
+inline void finishSphereLevel(SphereLodChain& chain, size_t firstIndex) {
+    float error = 0.0f;
+    for (size_t i = firstIndex; i + 2 < chain.indices.size(); i += 3) {
+        const float* a = &chain.vertices[chain.indices[i] * SphereLodChain::STRIDE];
+        const float* b = &chain.vertices[chain.indices[i + 1] * SphereLodChain::STRIDE];
+        const float* c = &chain.vertices[chain.indices[i + 2] * SphereLodChain::STRIDE];
+        const double e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const double e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        const double n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0)
+            error = std::max(error, static_cast<float>(1.0 - std::fabs(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]) / length));
+    }
+    chain.levels.push_back({static_cast<unsigned int>(firstIndex),
+                            static_cast<unsigned int>(chain.indices.size() - firstIndex), error});
+}
+
+// Spherical texture coordinates laid out like gluSphere with its pole along z: u runs around
+// the pole starting at +y, v from 0 at z = -1 to 1 at z = 1. Triangles that straddle the u = 0
+// seam get copies of their low-u vertices with u + 1, and a vertex on a pole gets a copy per
+// u it is used with (the mean u of the other two corners), so no triangle interpolates across
+// the whole texture.
+inline void assignSphereTexCoords(SphereLodChain& chain) {
+    const double twoPi = 2.0 * std::acos(-1.0);
+    const size_t baseCount = chain.vertexCount();
+    std::vector<bool> pole(baseCount);
+    for (size_t v = 0; v < baseCount; v++) {
+        float* vertex = &chain.vertices[v * SphereLodChain::STRIDE];
+        pole[v] = vertex[0] * vertex[0] + vertex[1] * vertex[1] < 1e-12f;
+        double u = pole[v] ? 0.0 : std::atan2(-vertex[0], vertex[1]) / twoPi;
+        if (u < 0.0)
+            u += 1.0;
+        vertex[3] = static_cast<float>(u);
+        vertex[4] = static_cast<float>(1.0 - std::acos(std::clamp(vertex[2], -1.0f, 1.0f)) / std::acos(-1.0));
+    }
+
+    // (vertex, bits of the new u) -> copy of the vertex with that u
+    std::unordered_map<uint64_t, unsigned int> copies;
+    auto copyWithU = [&](unsigned int vertex, float u) {
+        uint32_t bits;
+        std::memcpy(&bits, &u, sizeof(bits));
+        const uint64_t key = static_cast<uint64_t>(vertex) << 32 | bits;
+        auto found = copies.find(key);
+        if (found != copies.end())
+            return found->second;
+
+        const unsigned int copy = static_cast<unsigned int>(chain.vertexCount());
+        for (int component = 0; component < SphereLodChain::STRIDE; component++)
+            chain.vertices.push_back(chain.vertices[vertex * SphereLodChain::STRIDE + component]);
+        chain.vertices[copy * SphereLodChain::STRIDE + 3] = u;
+        copies.emplace(key, copy);
+        return copy;
+    };
+
+    for (size_t i = 0; i + 2 < chain.indices.size(); i += 3) {
+        float u[3];
+        float low = 1.0f, high = 0.0f;
+        for (int corner = 0; corner < 3; corner++) {
+            const unsigned int vertex = chain.indices[i + corner];
+            u[corner] = chain.vertices[vertex * SphereLodChain::STRIDE + 3];
+            if (!pole[vertex]) {
+                low = std::min(low, u[corner]);
+                high = std::max(high, u[corner]);
+            }
+        }
+
+        float sum = 0.0f;
+        int sides = 0;
+        for (int corner = 0; corner < 3; corner++) {
+            if (pole[chain.indices[i + corner]])
+                continue;
+            if (high - low > 0.5f && u[corner] < 0.5f)
+                u[corner] += 1.0f;
+            sum += u[corner];
+            sides++;
+        }
+
+        for (int corner = 0; corner < 3; corner++) {
+            unsigned int& vertex = chain.indices[i + corner];
+            if (pole[vertex])
+                vertex = copyWithU(vertex, sides > 0 ? sum / sides : 0.0f);
+            else if (u[corner] != chain.vertices[vertex * SphereLodChain::STRIDE + 3])
+                vertex = copyWithU(vertex, u[corner]);
+        }
+    }
+}
+
+// Icosahedron subdivided maxLevel times, level L has 20 * 4^L triangles. Each level splits
+// every edge of the previous one at its midpoint; the midpoint is looked up by edge, so the
+// two triangles sharing an edge share the new vertex, and the vertices of a level are a
+// prefix of those of the next.
+inline SphereLodChain generateIcosphere(int maxLevel, bool texCoords = true) {
+    SphereLodChain chain;
+
+    // Oriented with a vertex on each pole, two rings of five in between
+    const double pi = std::acos(-1.0);
+    const double ringZ = 1.0 / std::sqrt(5.0), ringRadius = 2.0 / std::sqrt(5.0);
+    appendSphereVertex(chain, 0.0, 0.0, 1.0);
+    for (int ring = 0; ring < 2; ring++) {
+        for (int i = 0; i < 5; i++) {
+            const double angle = (2.0 * i + ring) * pi / 5.0;
+            appendSphereVertex(chain, ringRadius * std::cos(angle), ringRadius * std::sin(angle), ring == 0 ? ringZ : -ringZ);
+        }
+    }
+    appendSphereVertex(chain, 0.0, 0.0, -1.0);
+
+    for (unsigned int i = 0; i < 5; i++) {
+        const unsigned int next = (i + 1) % 5;
+        chain.indices.insert(chain.indices.end(), {
+            0, 1 + i, 1 + next,
+            1 + i, 6 + i, 1 + next,
+            1 + next, 6 + i, 6 + next,
+            11, 6 + next, 6 + i
+        });
+    }
+
+    // Wind every face counter-clockwise seen from outside
+    for (size_t i = 0; i < chain.indices.size(); i += 3) {
+        const float* a = &chain.vertices[chain.indices[i] * SphereLodChain::STRIDE];
+        const float* b = &chain.vertices[chain.indices[i + 1] * SphereLodChain::STRIDE];
+        const float* c = &chain.vertices[chain.indices[i + 2] * SphereLodChain::STRIDE];
+        const float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        const float outward = (e1[1] * e2[2] - e1[2] * e2[1]) * (a[0] + b[0] + c[0])
+                            + (e1[2] * e2[0] - e1[0] * e2[2]) * (a[1] + b[1] + c[1])
+                            + (e1[0] * e2[1] - e1[1] * e2[0]) * (a[2] + b[2] + c[2]);
+        if (outward < 0.0f)
+            std::swap(chain.indices[i + 1], chain.indices[i + 2]);
+    }
+    finishSphereLevel(chain, 0);
+
+    std::unordered_map<uint64_t, unsigned int> midpoints;
+    for (int level = 1; level <= maxLevel; level++) {
+        const SphereLodChain::Level previous = chain.levels.back();
+        const size_t firstIndex = chain.indices.size();
+        midpoints.clear();
+
+        auto midpoint = [&](unsigned int a, unsigned int b) {
+            const uint64_t key = static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+            auto found = midpoints.find(key);
+            if (found != midpoints.end())
+                return found->second;
+
+            const unsigned int vertex = static_cast<unsigned int>(chain.vertexCount());
+            const float* pa = &chain.vertices[a * SphereLodChain::STRIDE];
+            const float* pb = &chain.vertices[b * SphereLodChain::STRIDE];
+            appendSphereVertex(chain, double(pa[0]) + pb[0], double(pa[1]) + pb[1], double(pa[2]) + pb[2]);
+            midpoints.emplace(key, vertex);
+            return vertex;
+        };
+
+        for (unsigned int i = previous.firstIndex; i < previous.firstIndex + previous.indexCount; i += 3) {
+            const unsigned int a = chain.indices[i], b = chain.indices[i + 1], c = chain.indices[i + 2];
+            const unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            chain.indices.insert(chain.indices.end(), {
+                a, ab, ca,
+                ab, b, bc,
+                ca, bc, c,
+                ab, bc, ca
+            });
+        }
+        finishSphereLevel(chain, firstIndex);
+    }
+
+    if (texCoords)
+        assignSphereTexCoords(chain);
+    return chain;
+}
+
+// Cube with 2^L x 2^L cells per face projected onto the sphere, level L has 12 * 4^L
+// triangles. Grid points are mapped with
+//   x' = x * sqrt(1 - y^2 / 2 - z^2 / 2 + y^2 z^2 / 3)
+// (and likewise for y, z), which keeps cell areas far more even than normalizing the cube
+// point. Vertices are keyed by their lattice position on the finest cube, so neighbouring
+// faces share their edge vertices and every level indexes the finest level's vertices.
+inline SphereLodChain generateCubeSphere(int maxLevel, bool texCoords = true) {
+    SphereLodChain chain;
+
+    // Outward axis, then the two in-face axes with u x v = outward
+    static const int FACES[6][3][3] = {
+        {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+        {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+        {{0, 1, 0}, {0, 0, 1}, {1, 0, 0}},
+        {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+        {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},
+        {{0, 0, -1}, {0, 1, 0}, {1, 0, 0}}
+    };
+
+    const int cells = 1 << maxLevel;
+    std::unordered_map<uint64_t, unsigned int> lattice;
+    auto vertexAt = [&](int face, int s, int t) {
+        int point[3];
+        for (int axis = 0; axis < 3; axis++)
+            point[axis] = FACES[face][0][axis] * cells + FACES[face][1][axis] * (2 * s - cells) + FACES[face][2][axis] * (2 * t - cells);
+
+        uint64_t key = 0;
+        for (int axis = 0; axis < 3; axis++)
+            key = key << 21 | static_cast<uint64_t>(point[axis] + cells);
+        auto found = lattice.find(key);
+        if (found != lattice.end())
+            return found->second;
+
+        const unsigned int vertex = static_cast<unsigned int>(chain.vertexCount());
+        const double x = double(point[0]) / cells, y = double(point[1]) / cells, z = double(point[2]) / cells;
+        appendSphereVertex(chain,
+                           x * std::sqrt(1.0 - y * y / 2.0 - z * z / 2.0 + y * y * z * z / 3.0),
+                           y * std::sqrt(1.0 - z * z / 2.0 - x * x / 2.0 + z * z * x * x / 3.0),
+                           z * std::sqrt(1.0 - x * x / 2.0 - y * y / 2.0 + x * x * y * y / 3.0));
+        lattice.emplace(key, vertex);
+        return vertex;
+    };
+
+    for (int level = 0; level <= maxLevel; level++) {
+        const size_t firstIndex = chain.indices.size();
+        const int step = cells >> level;
+        for (int face = 0; face < 6; face++) {
+            for (int s = 0; s < cells; s += step) {
+                for (int t = 0; t < cells; t += step) {
+                    const unsigned int a = vertexAt(face, s, t);
+                    const unsigned int b = vertexAt(face, s + step, t);
+                    const unsigned int c = vertexAt(face, s + step, t + step);
+                    const unsigned int d = vertexAt(face, s, t + step);
+                    chain.indices.insert(chain.indices.end(), {a, b, c, a, c, d});
+                }
+            }
+        }
+        finishSphereLevel(chain, firstIndex);
+    }
+
+    if (texCoords)
+        assignSphereTexCoords(chain);
+    return chain;
+}
+
+#endif //SPHEREGENERATORS_H
@@ -5,10 +5,16 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <chrono>
+#include <string>
 #include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "Random.h"
+#include "SphereDraw.h"
+#include "SphereGenerators.h"
+#include "MeshOptimizer.h"
+#include "GLStateCache.h"
 
 // Світлові джерела
 #define MAIN_LIGHT GL_LIGHT0
@@ -31,6 +37,12 @@
 GLuint starTexture;
 GLuint moonTexture;
 
+// Сфера з рівнями деталізації, спільна для всіх сферичних об'єктів
+SphereLodChain sphereLods;
+
+// Кеш стану OpenGL: відкидає виклики glEnable/glDisable/glBindTexture, що нічого не змінюють
+GLStateCache glState;
+
 // Камера
 float cameraX = 0.0f, cameraY = 0.0f, cameraZ = 20.0f;
 
@@ -60,16 +72,18 @@ struct MovingObject {
     float dx, dy, dz;     // Напрямок/швидкість
     float size;
     float rotX, rotY, rotZ; // Кути обертання
+    rng::Xoshiro256 random; // Власний потік випадкових чисел об'єкта
 
     // Ініціалізація з випадковою позицією та напрямком
-    explicit MovingObject(const float newSize) {
-        x = (float)rand() / RAND_MAX * 10.0f - 5.0f; // -5 до 5
-        y = (float)rand() / RAND_MAX * 6.0f - 3.0f;  // -3 до 3
-        z = (float)rand() / RAND_MAX * 10.0f - 5.0f; // -5 до 5
+    explicit MovingObject(const float newSize)
+        : random(rng::Xoshiro256::forStream(rng::globalSeed(), nextStreamId())) {
+        x = random.uniform(-5.0f, 5.0f); // -5 до 5
+        y = random.uniform(-3.0f, 3.0f); // -3 до 3
+        z = random.uniform(-5.0f, 5.0f); // -5 до 5
 
-        dx = ((float)rand() / RAND_MAX * 2.0f - 1.0f);
-        dy = ((float)rand() / RAND_MAX * 2.0f - 1.0f);
-        dz = ((float)rand() / RAND_MAX * 2.0f - 1.0f);
+        dx = random.uniform(-1.0f, 1.0f);
+        dy = random.uniform(-1.0f, 1.0f);
+        dz = random.uniform(-1.0f, 1.0f);
 
         // Нормалізація вектора швидкості
         float len = sqrt(dx*dx + dy*dy + dz*dz);
@@ -91,10 +105,10 @@ struct MovingObject {
         if (x < sceneBounds[0] || x > sceneBounds[1]) {
             dx = -dx;
             // Зміна напрямку (для ламаної траєкторії)
-            if (rand() % 4 == 0) {
+            if (random.below(4) == 0) {
                 // Додаються невеликі випадкові значення від -0.2 до 0.2
-                dy += ((float)rand() / RAND_MAX * 0.4f - 0.2f);
-                dz += ((float)rand() / RAND_MAX * 0.4f - 0.2f);
+                dy += random.uniform(-0.2f, 0.2f);
+                dz += random.uniform(-0.2f, 0.2f);
                 // Нормалізація
                 float len = sqrt(dx*dx + dy*dy + dz*dz);
                 dx /= len; dy /= len; dz /= len;
@@ -105,9 +119,9 @@ struct MovingObject {
         if (y < sceneBounds[2] || y > sceneBounds[3]) {
             dy = -dy;
             // Зміна напрямку
-            if (rand() % 4 == 0) {
-                dx += ((float)rand() / RAND_MAX * 0.4f - 0.2f);
-                dz += ((float)rand() / RAND_MAX * 0.4f - 0.2f);
+            if (random.below(4) == 0) {
+                dx += random.uniform(-0.2f, 0.2f);
+                dz += random.uniform(-0.2f, 0.2f);
                 // Нормалізація
                 float len = sqrt(dx*dx + dy*dy + dz*dz);
                 dx /= len; dy /= len; dz /= len;
@@ -118,9 +132,9 @@ struct MovingObject {
         if (z < sceneBounds[4] || z > sceneBounds[5]) {
             dz = -dz;
             // Зміна напрямку
-            if (rand() % 4 == 0) {
-                dx += ((float)rand() / RAND_MAX * 0.4f - 0.2f);
-                dy += ((float)rand() / RAND_MAX * 0.4f - 0.2f);
+            if (random.below(4) == 0) {
+                dx += random.uniform(-0.2f, 0.2f);
+                dy += random.uniform(-0.2f, 0.2f);
                 // Нормалізація
                 float len = sqrt(dx*dx + dy*dy + dz*dz);
                 dx /= len; dy /= len; dz /= len;
@@ -133,6 +147,12 @@ struct MovingObject {
         rotY += 2.0f * rotation * deltaTime;
         rotZ += 1.0f * rotation * deltaTime;
     }
+
+    // Номер потоку для кожного нового об'єкта, щоб сцена відтворювалася з тим самим зерном
+    static uint64_t nextStreamId() {
+        static uint64_t counter = 0;
+        return counter++;
+    }
 };
 
 auto sun = MovingObject(4.0f);
@@ -202,6 +222,17 @@ void init(void) {
     moonTexture = loadTexture("..\\Textures\\moon-texture.jpg");
     starTexture = loadTexture("..\\Textures\\star_texture.jpg");
 
+    // Рівні деталізації сфери: куб із 2^L x 2^L клітинками на грань, спроектований на сферу.
+    // Рівень 3 - найдрібніший, що вкладається в кількість трикутників колишніх gluSphere
+    sphereLods = generateCubeSphere(3);
+    // Кожен рівень окремо впорядковується для кешу вершин; вершини спільні для всіх рівнів
+    for (size_t l = 0; l < sphereLods.levels.size(); l++) {
+        const SphereLodChain::Level& level = sphereLods.levels[l];
+        const std::string levelName = "Sphere level " + std::to_string(l);
+        printMeshOptimization(levelName.c_str(), optimizeIndexRange(sphereLods.indices, level.firstIndex,
+                                                                    level.indexCount, sphereLods.vertexCount()));
+    }
+
     // Створення контекстного меню
     createMenu();
 
@@ -260,14 +291,14 @@ void setupLighting() {
     glLightf(THIRD_LIGHT, GL_QUADRATIC_ATTENUATION, 0.001f);
 
     // Увімкнення/вимкнення джерел світла відповідно до налаштувань
-    if (mainLightEnabled) glEnable(MAIN_LIGHT);
-    else glDisable(MAIN_LIGHT);
+    if (mainLightEnabled) glState.enable(MAIN_LIGHT);
+    else glState.disable(MAIN_LIGHT);
 
-    if (secondLightEnabled) glEnable(SECOND_LIGHT);
-    else glDisable(SECOND_LIGHT);
+    if (secondLightEnabled) glState.enable(SECOND_LIGHT);
+    else glState.disable(SECOND_LIGHT);
 
-    if (thirdLightEnabled) glEnable(THIRD_LIGHT);
-    else glDisable(THIRD_LIGHT);
+    if (thirdLightEnabled) glState.enable(THIRD_LIGHT);
+    else glState.disable(THIRD_LIGHT);
 }
 
 // Малювання зірки
@@ -289,8 +320,8 @@ void drawStar(const MovingObject& obj) {
     glMaterialfv(GL_FRONT, GL_EMISSION, mat_emission);
 
     // Застосування текстури зірки
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, starTexture);
+    glState.enable(GL_TEXTURE_2D);
+    glState.bindTexture(GL_TEXTURE_2D, starTexture);
 
     glPushMatrix();
     glTranslatef(obj.x, obj.y, obj.z);
@@ -299,13 +330,9 @@ void drawStar(const MovingObject& obj) {
     glRotatef(obj.rotZ, 0.0f, 0.0f, 1.0f);
 
     // Малювання сфери зірки
-    GLUquadricObj *quadric = gluNewQuadric();
-    gluQuadricTexture(quadric, GL_TRUE);
-    gluSphere(quadric, obj.size / 2.0f, 30, 30);
-    gluDeleteQuadric(quadric);
+    drawLodSphere(sphereLods, obj.size / 2.0f, 30, 30);
 
     glPopMatrix();
-    glDisable(GL_TEXTURE_2D);
     glPopAttrib();
 }
 
@@ -326,8 +353,8 @@ void drawPlanet(const MovingObject& obj) {
     glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
     glMaterialfv(GL_FRONT, GL_EMISSION, mat_emission);
 
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, moonTexture);
+    glState.enable(GL_TEXTURE_2D);
+    glState.bindTexture(GL_TEXTURE_2D, moonTexture);
 
     glPushMatrix();
     glTranslatef(obj.x, obj.y, obj.z);
@@ -336,18 +363,17 @@ void drawPlanet(const MovingObject& obj) {
     glRotatef(obj.rotZ, 0.0f, 0.0f, 1.0f);
 
     // Створення сфери планети
-    GLUquadricObj *quadric = gluNewQuadric();
-    gluQuadricTexture(quadric, GL_TRUE);
-    gluSphere(quadric, obj.size / 2.0f, 20, 20);
-    gluDeleteQuadric(quadric);
+    drawLodSphere(sphereLods, obj.size / 2.0f, 20, 20);
 
     glPopMatrix();
-    glDisable(GL_TEXTURE_2D);
     glPopAttrib();
 }
 
 // Малювання меж сцени (для демонстрації)
 void drawSceneBounds() {
+    // Текстура вимикається лише тут: зоря і планета залишають її увімкненою одна для одної
+    glState.disable(GL_TEXTURE_2D);
+
     glPushAttrib(GL_LIGHTING_BIT | GL_LINE_BIT);
     glDisable(GL_LIGHTING);
 
@@ -641,6 +667,13 @@ void idle() {
     glutPostRedisplay();
 }
 
+// Виведення лічильників кешу стану при завершенні програми
+void printStateCalls() {
+    const GLStateCounters& stateCalls = glState.counters();
+    printf("GL state calls: %llu issued, %llu elided\n",
+           (unsigned long long)stateCalls.issued, (unsigned long long)stateCalls.elided);
+}
+
 // Головна функція
 int main(int argc, char** argv) {
     // Ініціалізація GLUT
@@ -661,6 +694,7 @@ int main(int argc, char** argv) {
 
     // Ініціалізація OpenGL
     init();
+    atexit(printStateCalls);
 
     // Запуск анімації
     glutTimerFunc(16, animate, 0);